@@ -2,9 +2,14 @@
 #define COUNTERS_IMPL_H
 
 #include <atomic>
+#include <cassert>
 #include <mutex>
+#include <condition_variable>
+#include <thread>
+#include "numa_tools.h"
 
 #define MAX_THREADS 256
+#define MAX_NODES 8
 
 class CounterNaive {
 private:
@@ -48,7 +53,7 @@ class CounterFetchAndAdd {
 private:
     atomic<int> v;
 public:
-    CounterFetchAndAdd(int _numThreads) {
+    CounterFetchAndAdd(int _numThreads) : v(0) {
     }
     int64_t inc(int tid) {
         return v++;
@@ -95,6 +100,105 @@ public:
 };
 
 
+// Approximate counter whose error is bounded by a budget given to the constructor, rather than growing
+// with the number of threads. The budget is absoluteError, or relativeError * (current value) if that is
+// larger. Each active thread may keep up to (budget / activeThreads) - 1 unflushed increments, and a thread
+// recomputes its flush threshold whenever it flushes or notices that the number of active threads changed.
+// A thread becomes active on its first inc(), and should call deregister() when it stops incrementing.
+class CounterBoundedApproximate {
+public:
+    struct bounded_value_t {
+        int64_t value;      // value of the global counter
+        int64_t maxError;   // the real count is in [value, value + maxError]
+    };
+private:
+    static constexpr int64_t DEFAULT_ABSOLUTE_ERROR = 1 << 16;
+    const int64_t absoluteError;
+    const double relativeError;
+    char padding0[64];
+    struct padded_local {
+        int64_t localCount;
+        int64_t threshold;      // flush once localCount reaches this (0 means the thread is not active)
+        int64_t seenActive;     // number of active threads when threshold was computed
+        char padding[192-3*sizeof(int64_t)];
+    };
+    padded_local localCounts[MAX_THREADS];
+    // written only when a thread flushes (or changes its threshold)
+    atomic<int64_t> globalCount;
+    atomic<int64_t> allowance;  // sum over active threads of (threshold - 1): the maximum possible unflushed count
+    char padding1[192-2*sizeof(int64_t)];
+    // read on every inc(), but written only when a thread registers or deregisters
+    atomic<int64_t> activeThreads;
+    char padding2[192-sizeof(int64_t)];
+
+    int64_t computeThreshold(int64_t active) {
+        int64_t budget = max(absoluteError, (int64_t) (relativeError * globalCount.load(memory_order_relaxed)));
+        return max((int64_t) 1, budget / max(active, (int64_t) 1));
+    }
+    void flushAndRecompute(int tid, int64_t active) {
+        auto & local = localCounts[tid];
+        if (local.localCount) globalCount.fetch_add(local.localCount);
+        local.localCount = 0;
+        int64_t newThreshold = computeThreshold(active);
+        if (newThreshold != local.threshold) {
+            allowance.fetch_add(newThreshold - local.threshold);
+            local.threshold = newThreshold;
+        }
+        local.seenActive = active;
+    }
+public:
+    CounterBoundedApproximate(int _numThreads, int64_t _absoluteError = DEFAULT_ABSOLUTE_ERROR, double _relativeError = 0)
+    : absoluteError(_absoluteError), relativeError(_relativeError) {
+        for (int i = 0; i < MAX_THREADS; ++i){
+            localCounts[i].localCount = 0;
+            localCounts[i].threshold = 0;
+            localCounts[i].seenActive = 0;
+        }
+        globalCount = 0;
+        allowance = 0;
+        activeThreads = 0;
+    }
+    // returns a value v such that v <= (real count after this increment) <= v + readWithBound().maxError
+    int64_t inc(int tid) {
+        auto & local = localCounts[tid];
+        if (local.threshold == 0) {
+            // first increment by this thread: register it (the threshold starts at 1, so allowance += 0)
+            local.threshold = 1;
+            flushAndRecompute(tid, activeThreads.fetch_add(1) + 1);
+        }
+        int64_t active = activeThreads.load(memory_order_relaxed);
+        ++local.localCount;
+        if (local.localCount >= local.threshold || active != local.seenActive) {
+            int64_t flushed = local.localCount;
+            int64_t before = globalCount.fetch_add(flushed);
+            local.localCount = 0;
+            flushAndRecompute(tid, active);
+            return before + flushed;
+        }
+        return globalCount.load(memory_order_relaxed) + local.localCount;
+    }
+    // flush this thread's remaining increments and stop counting it as active
+    void deregister(int tid) {
+        auto & local = localCounts[tid];
+        if (local.threshold == 0) return;
+        if (local.localCount) globalCount.fetch_add(local.localCount);
+        local.localCount = 0;
+        allowance.fetch_add(1 - local.threshold);
+        local.threshold = 0;
+        activeThreads.fetch_add(-1);
+    }
+    int64_t read() {
+        return globalCount;
+    }
+    // the bound is exact with respect to flushes that complete before the call, and may be off by the
+    // threshold change of a thread that concurrently flushes
+    bounded_value_t readWithBound() {
+        int64_t value = globalCount;
+        int64_t maxError = allowance;
+        return {value, maxError};
+    }
+};
+
 class CounterShardedLocked {
 private:
     int numThreads;
@@ -151,6 +255,7 @@ public:
     }
     int64_t inc(int tid) {
         shards[tid].count++;
+        return 0;
     }
     int64_t read() {
         // sum is made atmoic to make sure the read and write is indivisible, which makes it easier to prove.
@@ -162,5 +267,302 @@ public:
     }
 };
 
+
+// Sharded counter with a per-shard sequence number (seqlock). The owner of a shard makes its sequence
+// number odd, updates the count, then makes it even again; these are plain stores (no atomic RMW), since
+// each shard has a single writer. read() takes an optimistic snapshot: it collects every shard's
+// (sequence number, count) and then re-checks the sequence numbers, retrying if any shard was being
+// written or changed in between. A successful attempt is a consistent snapshot of all shards, and writers
+// are never blocked by readers (unlike CounterShardedLocked). If MAX_READ_RETRIES attempts all conflict,
+// read() returns the sum from its last collect, which is still a linearizable value for a counter that only
+// increments by one (it lies between the values at the start and end of the read).
+class CounterShardedSeqlock {
+private:
+    static const int MAX_READ_RETRIES = 64;
+    int numThreads;
+    struct SLCS {
+        atomic<uint64_t> seq;
+        atomic<int64_t> count;
+        char padding[192-sizeof(uint64_t)-sizeof(int64_t)];
+    };
+    SLCS shards[MAX_THREADS];
+public:
+    CounterShardedSeqlock(int _numThreads) {
+        for (int i = 0; i < MAX_THREADS; ++i){
+            shards[i].seq = 0;
+            shards[i].count = 0;
+        }
+        numThreads = _numThreads;
+    }
+    int64_t inc(int tid) {
+        auto & shard = shards[tid];
+        uint64_t seq = shard.seq.load(memory_order_relaxed);
+        shard.seq.store(seq + 1, memory_order_relaxed);
+        atomic_thread_fence(memory_order_release); // the odd seq must be visible before the new count
+        shard.count.store(shard.count.load(memory_order_relaxed) + 1, memory_order_relaxed);
+        shard.seq.store(seq + 2, memory_order_release);
+        return 0;
+    }
+    int64_t read() {
+        uint64_t seqs[MAX_THREADS];
+        int64_t sum = 0;
+        for (int attempt = 0; attempt < MAX_READ_RETRIES; ++attempt) {
+            bool consistent = true;
+            sum = 0;
+            for (int tid = 0; tid < numThreads; ++tid) {
+                seqs[tid] = shards[tid].seq.load(memory_order_acquire);
+                sum += shards[tid].count.load(memory_order_relaxed);
+                if (seqs[tid] & 1) consistent = false;
+            }
+            if (!consistent) continue;
+            atomic_thread_fence(memory_order_acquire); // count reads must complete before the validating seq reads
+            for (int tid = 0; tid < numThreads; ++tid) {
+                if (shards[tid].seq.load(memory_order_relaxed) != seqs[tid]) { consistent = false; break; }
+            }
+            if (consistent) return sum;
+        }
+        return sum;
+    }
+};
+
+// Hierarchical counter: per-thread (per-core) shards -> per-socket partial sums -> global total.
+// The socket a thread is running on is taken from the cpu/node mapping computed by NumaTools
+// (re-sampled periodically, so a thread that migrates simply starts adding to its new socket).
+// Since socket sums are just partial sums, read() only has to touch MAX_NODES cache lines
+// (one per socket) instead of one line per thread.
+//
+// BATCH_UPDATES == false (read-heavy mode): inc() does a fetch&add on its socket's partial sum,
+//      so contention stays within one socket and read() is exact.
+// BATCH_UPDATES == true (update-heavy mode): inc() only touches the thread's own shard, and
+//      folds it into the socket's partial sum once it reaches FLUSH_THRESHOLD. read() is then
+//      approximate, and lags the real value by at most numThreads * (FLUSH_THRESHOLD-1).
+template <bool BATCH_UPDATES>
+class CounterHierarchical {
+private:
+    static constexpr int64_t FLUSH_THRESHOLD = 64;
+    int numThreads;
+    int numNodes;
+    struct HCS {
+        atomic<int64_t> count;
+        char padding[192-sizeof(int64_t)];
+    };
+    char padding0[192];
+    HCS nodes[MAX_NODES];
+    HCS shards[MAX_THREADS];
+
+    int myNode() {
+        return __numa.get_node_periodic() % numNodes;
+    }
+public:
+    CounterHierarchical(int _numThreads) {
+        for (int i = 0; i < MAX_NODES; ++i){
+            nodes[i].count = ATOMIC_VAR_INIT(0);
+        }
+        for (int i = 0; i < MAX_THREADS; ++i){
+            shards[i].count = ATOMIC_VAR_INIT(0);
+        }
+        numThreads = _numThreads;
+        numNodes = min(__numa.get_num_nodes(), MAX_NODES);
+    }
+    int64_t inc(int tid) {
+        if (!BATCH_UPDATES) {
+            nodes[myNode()].count.fetch_add(1, memory_order_relaxed);
+            return 0;
+        }
+        // only this thread writes its shard, so a load and a store suffice (no atomic RMW needed)
+        int64_t local = shards[tid].count.load(memory_order_relaxed) + 1;
+        if (local >= FLUSH_THRESHOLD) {
+            nodes[myNode()].count.fetch_add(local, memory_order_relaxed);
+            local = 0;
+        }
+        shards[tid].count.store(local, memory_order_relaxed);
+        return 0;
+    }
+    int64_t read() {
+        int64_t sum = 0;
+        for (int node = 0; node < numNodes; ++node){
+            sum += nodes[node].count;
+        }
+        return sum;
+    }
+};
+
+// Flat combining: each thread announces its increment in its own slot, and whichever thread acquires
+// the combiner lock collects all announced increments, applies them with a single fetch&add, and hands
+// each participant its exact ticket (the counter value before its own increment). Linearizable.
+class CounterFlatCombining {
+private:
+    int numThreads;
+    struct FCSlot {
+        atomic<int64_t> pending;
+        int64_t result;     // written by the combiner before it clears pending
+        char padding[192-2*sizeof(int64_t)];
+    };
+    char padding0[192];
+    atomic<bool> combinerLock;
+    char padding1[192-sizeof(bool)];
+    atomic<int64_t> v;
+    char padding2[192-sizeof(int64_t)];
+    FCSlot slots[MAX_THREADS];
+
+    void combine() {
+        int announced[MAX_THREADS];
+        int k = 0;
+        for (int i = 0; i < numThreads; ++i){
+            if (slots[i].pending.load(memory_order_acquire)) announced[k++] = i;
+        }
+        int64_t base = v.fetch_add(k);
+        for (int j = 0; j < k; ++j){
+            slots[announced[j]].result = base + j;
+            slots[announced[j]].pending.store(0, memory_order_release);
+        }
+    }
+public:
+    CounterFlatCombining(int _numThreads) : v(0) {
+        for (int i = 0; i < MAX_THREADS; ++i){
+            slots[i].pending = 0;
+            slots[i].result = 0;
+        }
+        combinerLock = false;
+        numThreads = _numThreads;
+    }
+    int64_t inc(int tid) {
+        slots[tid].pending.store(1, memory_order_release);
+        while (true) {
+            if (!combinerLock.load(memory_order_relaxed) && !combinerLock.exchange(true, memory_order_acquire)) {
+                combine(); // our own request was announced before we took the lock, so it is served here
+                combinerLock.store(false, memory_order_release);
+            }
+            if (!slots[tid].pending.load(memory_order_acquire)) return slots[tid].result;
+            std::this_thread::yield();
+        }
+    }
+    int64_t read() {
+        return v;
+    }
+};
+
+// Software combining tree (Herlihy & Shavit, The Art of Multiprocessor Programming, ch. 12).
+// Two threads share each leaf. A thread climbs until it finds a node where no other thread
+// is waiting to combine, adds its (and any combined partner's) increments at that node, and
+// the combined total reaches the root, where it is applied with a single fetch&add. Results are
+// then distributed back down so that each thread gets its exact ticket. Linearizable.
+class CounterCombiningTree {
+private:
+    enum CStatus { IDLE, FIRST, SECOND, RESULT, ROOT };
+    struct Node {
+        std::mutex m;
+        std::condition_variable cv;
+        bool locked = false;
+        CStatus cStatus = IDLE;
+        int64_t firstValue = 0;
+        int64_t secondValue = 0;
+        int64_t result = 0;
+        atomic<int64_t> rootValue; // only used by the root
+        Node * parent = NULL;
+        char padding[192];
+
+        bool precombine() {
+            std::unique_lock<std::mutex> lock(m);
+            cv.wait(lock, [this]{ return !locked; });
+            switch (cStatus) {
+                case IDLE: cStatus = FIRST; return true;
+                case FIRST: locked = true; cStatus = SECOND; return false;
+                case ROOT: return false;
+                default: assert(false); return false;
+            }
+        }
+        int64_t combine(int64_t combined) {
+            std::unique_lock<std::mutex> lock(m);
+            cv.wait(lock, [this]{ return !locked; });
+            locked = true;
+            firstValue = combined;
+            switch (cStatus) {
+                case FIRST: return firstValue;
+                case SECOND: return firstValue + secondValue;
+                default: assert(false); return 0;
+            }
+        }
+        int64_t op(int64_t combined) {
+            if (parent == NULL) {
+                return rootValue.fetch_add(combined); // the single fetch&add for the whole combined batch
+            }
+            std::unique_lock<std::mutex> lock(m);
+            assert(cStatus == SECOND);
+            secondValue = combined;
+            locked = false;
+            cv.notify_all();
+            cv.wait(lock, [this]{ return cStatus == RESULT; });
+            locked = false;
+            cStatus = IDLE;
+            cv.notify_all();
+            return result;
+        }
+        void distribute(int64_t prior) {
+            std::unique_lock<std::mutex> lock(m);
+            switch (cStatus) {
+                case FIRST: cStatus = IDLE; locked = false; break;
+                case SECOND: result = prior + firstValue; cStatus = RESULT; break;
+                default: assert(false);
+            }
+            cv.notify_all();
+        }
+    };
+
+    int numThreads;
+    int width;      // number of leaves * 2 (a power of two, at least 2)
+    Node * nodes;   // nodes[0] is the root, and the parent of nodes[i] is nodes[(i-1)/2]
+    Node ** leaves;
+public:
+    CounterCombiningTree(int _numThreads) {
+        numThreads = _numThreads;
+        width = 2;
+        while (width < numThreads) width *= 2;
+        nodes = new Node[width - 1];
+        nodes[0].cStatus = ROOT;
+        nodes[0].rootValue = 0;
+        for (int i = 1; i < width - 1; ++i){
+            nodes[i].parent = &nodes[(i-1)/2];
+        }
+        leaves = new Node*[width / 2];
+        for (int i = 0; i < width / 2; ++i){
+            leaves[i] = &nodes[width - 2 - i];
+        }
+    }
+    ~CounterCombiningTree() {
+        delete[] leaves;
+        delete[] nodes;
+    }
+    int64_t inc(int tid) {
+        Node * path[64];
+        int depth = 0;
+        Node * myLeaf = leaves[tid / 2];
+
+        // precombining phase: mark the path up to the first node where we must stop
+        Node * node = myLeaf;
+        while (node->precombine()) node = node->parent;
+        Node * stop = node;
+
+        // combining phase: collect our partners' increments on the way up
+        node = myLeaf;
+        int64_t combined = 1;
+        while (node != stop) {
+            combined = node->combine(combined);
+            path[depth++] = node;
+            node = node->parent;
+        }
+
+        // operation phase
+        int64_t prior = stop->op(combined);
+
+        // distribution phase
+        while (depth > 0) path[--depth]->distribute(prior);
+        return prior;
+    }
+    int64_t read() {
+        return nodes[0].rootValue;
+    }
+};
+
 #endif
 
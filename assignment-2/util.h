@@ -1,8 +1,13 @@
 #ifndef UTIL_H
 #define UTIL_H
 
+#include <algorithm>
 #include <atomic>
 #include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <time.h>
 
 class ElapsedTimer {
 private:
@@ -41,4 +46,87 @@ public:
     }
 };
 
+// cycle counter (rdtsc on x86, as in assignment-7's server_clock.h, otherwise nanoseconds)
+inline uint64_t get_cycles() {
+#if defined(__x86_64__)
+    unsigned hi, lo;
+    __asm__ __volatile__ ("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t) lo) | (((uint64_t) hi) << 32);
+#else
+    timespec tp;
+    clock_gettime(CLOCK_MONOTONIC, &tp);
+    return tp.tv_sec * 1000000000ULL + tp.tv_nsec;
+#endif
+}
+
+// log-bucketed latency histogram. each power of two is split into 2^SUB_BITS linear sub-buckets,
+// so any recorded value is reported with a relative error of at most 1/2^SUB_BITS.
+// meant to be owned by a single thread (no synchronization), and merged into a total after the threads join.
+class LatencyHistogram {
+private:
+    static const int SUB_BITS = 3;
+    static const int SUB_BUCKETS = 1 << SUB_BITS;
+    static const int NUM_BUCKETS = (64 - SUB_BITS + 1) * SUB_BUCKETS;
+    char padding0[64];
+    int64_t buckets[NUM_BUCKETS];
+    int64_t numSamples;
+    uint64_t maxValue;
+    char padding1[64];
+
+    static int bucketOf(uint64_t v) {
+        if (v < SUB_BUCKETS) return v;
+        int msb = 63 - __builtin_clzll(v);
+        int shift = msb - SUB_BITS;
+        return (shift + 1) * SUB_BUCKETS + ((v >> shift) & (SUB_BUCKETS - 1));
+    }
+    // largest value that maps to bucket b
+    static uint64_t upperBoundOf(int b) {
+        if (b < SUB_BUCKETS) return b;
+        int shift = b / SUB_BUCKETS - 1;
+        uint64_t sub = b % SUB_BUCKETS;
+        return ((SUB_BUCKETS + sub + 1) << shift) - 1;
+    }
+public:
+    LatencyHistogram() {
+        clear();
+    }
+    void clear() {
+        memset(buckets, 0, sizeof(buckets));
+        numSamples = 0;
+        maxValue = 0;
+    }
+    void add(uint64_t v) {
+        ++buckets[bucketOf(v)];
+        ++numSamples;
+        if (v > maxValue) maxValue = v;
+    }
+    void merge(const LatencyHistogram & other) {
+        for (int b = 0; b < NUM_BUCKETS; ++b) buckets[b] += other.buckets[b];
+        numSamples += other.numSamples;
+        if (other.maxValue > maxValue) maxValue = other.maxValue;
+    }
+    int64_t getNumSamples() {
+        return numSamples;
+    }
+    uint64_t getMax() {
+        return maxValue;
+    }
+    // returns an upper bound on the value at fraction q (e.g., 0.99) of the recorded distribution
+    uint64_t getPercentile(double q) {
+        if (numSamples == 0) return 0;
+        int64_t rank = (int64_t) (q * numSamples);
+        if (rank >= numSamples) rank = numSamples - 1;
+        int64_t seen = 0;
+        for (int b = 0; b < NUM_BUCKETS; ++b) {
+            seen += buckets[b];
+            if (seen > rank) return std::min(upperBoundOf(b), maxValue);
+        }
+        return maxValue;
+    }
+    void print(const char * label) {
+        printf("%s latency (cycles): p50=%lu p99=%lu p99.9=%lu max=%lu samples=%ld\n", label,
+                getPercentile(0.5), getPercentile(0.99), getPercentile(0.999), getMax(), getNumSamples());
+    }
+};
+
 #endif /* UTIL_H */
@@ -28,28 +28,50 @@ struct globals_t {
     
     char padding3[64];
     
+    // same as incrementsPerformed, but for read operations
+    atomic<int64_t> readsPerformed;
+    
+    char padding3b[64];
+    
     CounterType * counter;
     
     char padding4[64];
     
+    // per-thread latency histograms (each has padding built in), used only if latencySampleEvery > 0
+    LatencyHistogram * incLatency;
+    LatencyHistogram * readLatency;
+    
+    char padding4b[64];
+    
     int64_t numThreads;
     int64_t millisToRun;
+    int64_t readPercent;        // percentage of operations that are read() instead of inc()
+    int64_t latencySampleEvery; // time one out of every X operations (0 means no latency measurement)
+    int64_t numReaders;         // number of dedicated reader threads, in addition to the numThreads incrementers
     
     char padding5[64];
 
-    globals_t(int64_t numThreads, int64_t millisToRun) {
-        barrier = new Barrier(1+numThreads);
+    globals_t(int64_t numThreads, int64_t millisToRun, int64_t readPercent = 0, int64_t latencySampleEvery = 0, int64_t numReaders = 0) {
+        barrier = new Barrier(1+numThreads+numReaders);
         timer = new ElapsedTimer();
         incrementsPerformed = 0;
+        readsPerformed = 0;
         counter = new CounterType(numThreads);
         this->numThreads = numThreads;
         this->millisToRun = millisToRun;
+        this->readPercent = readPercent;
+        this->latencySampleEvery = latencySampleEvery;
+        this->numReaders = numReaders;
+        incLatency = new LatencyHistogram[numThreads+numReaders];
+        readLatency = new LatencyHistogram[numThreads+numReaders];
     }
     ~globals_t() {
         // manually free memory for objects allocated with "new"
         delete barrier;
         delete timer;
         delete counter;
+        delete[] incLatency;
+        delete[] readLatency;
     }
 };
 
@@ -59,20 +81,49 @@ void threadFunc(int tid, globals_t<CounterType> * g) {
     g->barrier->wait();
     printf("thread %d start (counter=%ld)\n", tid, g->counter->read());
 
-    // do increments
+    // do increments (and, if readPercent > 0, reads: deterministically, readPercent out of every 100 operations)
     int64_t last = 0;
+    int64_t reads = 0;
     int64_t i;
     for (i=0; ; ++i) {
-        last = g->counter->inc(tid);
+        const bool timed = g->latencySampleEvery && (i % g->latencySampleEvery) == 0;
+        const uint64_t startCycles = timed ? get_cycles() : 0;
+        if (g->readPercent && (i % 100) < g->readPercent) {
+            last = g->counter->read();
+            ++reads;
+            if (timed) g->readLatency[tid].add(get_cycles() - startCycles);
+        } else {
+            last = g->counter->inc(tid);
+            if (timed) g->incLatency[tid].add(get_cycles() - startCycles);
+        }
 
         // check timer to see if we should terminate
         // (to reduce overhead of timing calls, do this only once every X increments)
         if ((i & 1023) == 0) if (g->timer->getElapsedMillis() >= g->millisToRun) break;
     }
-    g->incrementsPerformed.fetch_add(i+1);
+    g->incrementsPerformed.fetch_add(i+1-reads);
+    g->readsPerformed.fetch_add(reads);
     printf("thread %d end (last counter value seen %ld)\n", tid, last);
 }
 
+// dedicated reader thread: only calls read(), so read latency can be measured while incrementers run
+template <class CounterType>
+void readerFunc(int tid, globals_t<CounterType> * g) {
+    g->barrier->wait();
+
+    int64_t last = 0;
+    int64_t i;
+    for (i=0; ; ++i) {
+        const bool timed = g->latencySampleEvery && (i % g->latencySampleEvery) == 0;
+        const uint64_t startCycles = timed ? get_cycles() : 0;
+        last = g->counter->read();
+        if (timed) g->readLatency[tid].add(get_cycles() - startCycles);
+        if ((i & 1023) == 0) if (g->timer->getElapsedMillis() >= g->millisToRun) break;
+    }
+    g->readsPerformed.fetch_add(i+1);
+    printf("reader %d end (last counter value seen %ld)\n", tid, last);
+}
+
 template <class CounterType>
 void runExperiment(globals_t<CounterType> * g) {
     
@@ -81,6 +132,9 @@ void runExperiment(globals_t<CounterType> * g) {
     for (int tid=0; tid < g->numThreads; ++tid) {
         threads.push_back(new thread(threadFunc<CounterType>, tid, g));
     }
+    for (int tid=g->numThreads; tid < g->numThreads + g->numReaders; ++tid) {
+        threads.push_back(new thread(readerFunc<CounterType>, tid, g));
+    }
     
     g->timer->start();
     g->barrier->wait();
@@ -94,33 +148,61 @@ void runExperiment(globals_t<CounterType> * g) {
     printf("\n");
     printf("final counter value after %ld increments is %ld\n", g->incrementsPerformed.load(), g->counter->read());
     printf("increments/s: %ld\n", g->incrementsPerformed.load() * 1000 / g->millisToRun);
+    if (g->readPercent || g->numReaders) printf("reads/s: %ld\n", g->readsPerformed.load() * 1000 / g->millisToRun);
+    if (g->latencySampleEvery) {
+        LatencyHistogram incTotal, readTotal;
+        for (int tid=0; tid < g->numThreads + g->numReaders; ++tid) {
+            incTotal.merge(g->incLatency[tid]);
+            readTotal.merge(g->readLatency[tid]);
+        }
+        incTotal.print("inc");
+        if (readTotal.getNumSamples()) readTotal.print("read");
+    }
     printf("\n");
 }
 
 int main(int argc, char ** argv) {
     // parse command line args
-    if (argc != 4) {
-        printf("USAGE: %s NUM_THREADS MILLIS_TO_RUN COUNTER_TYPE_NAME\n", argv[0]);
-        printf("       where COUNTER_TYPE_NAME in {naive, lock, faa, approx, shard_lock, shard_wf}\n");
+    if (argc < 4 || argc > 7) {
+        printf("USAGE: %s NUM_THREADS MILLIS_TO_RUN COUNTER_TYPE_NAME [READ_PERCENT [LATENCY_SAMPLE_EVERY [NUM_READERS]]]\n", argv[0]);
+        printf("       where COUNTER_TYPE_NAME in {naive, lock, faa, approx, approx_bounded, shard_lock, shard_wf, shard_seqlock, fc, ctree, hier_read, hier_update}\n");
+        printf("       and READ_PERCENT (default 0) is the percentage of operations that call read() instead of inc()\n");
+        printf("       LATENCY_SAMPLE_EVERY (default 0 = off) times one out of every X operations and reports p50/p99/p99.9\n");
+        printf("       and NUM_READERS (default 0) is the number of dedicated reader threads run alongside the incrementers\n");
         return 1;
     }
     const int numThreads = atoll(argv[1]);
     const int millisToRun = atoll(argv[2]);
+    const int readPercent = (argc > 4) ? atoll(argv[4]) : 0;
+    const int latencySampleEvery = (argc > 5) ? atoll(argv[5]) : 0;
+    const int numReaders = (argc > 6) ? atoll(argv[6]) : 0;
 
     // create the counter that threads will access and invoke runExperiment
     // (providing counter type information via templates -- orders of magnitude faster than polymorphism)
     if (!strcmp(argv[3], "naive")) {
-        runExperiment(new globals_t<CounterNaive>(numThreads, millisToRun));
+        runExperiment(new globals_t<CounterNaive>(numThreads, millisToRun, readPercent, latencySampleEvery, numReaders));
     } else if (!strcmp(argv[3], "lock")) {
-        runExperiment(new globals_t<CounterLocked>(numThreads, millisToRun));
+        runExperiment(new globals_t<CounterLocked>(numThreads, millisToRun, readPercent, latencySampleEvery, numReaders));
     } else if (!strcmp(argv[3], "faa")) {
-        runExperiment(new globals_t<CounterFetchAndAdd>(numThreads, millisToRun));
+        runExperiment(new globals_t<CounterFetchAndAdd>(numThreads, millisToRun, readPercent, latencySampleEvery, numReaders));
     } else if (!strcmp(argv[3], "approx")) {
-        runExperiment(new globals_t<CounterApproximate>(numThreads, millisToRun));
+        runExperiment(new globals_t<CounterApproximate>(numThreads, millisToRun, readPercent, latencySampleEvery, numReaders));
+    } else if (!strcmp(argv[3], "approx_bounded")) {
+        runExperiment(new globals_t<CounterBoundedApproximate>(numThreads, millisToRun, readPercent, latencySampleEvery, numReaders));
     } else if (!strcmp(argv[3], "shard_lock")) {
-        runExperiment(new globals_t<CounterShardedLocked>(numThreads, millisToRun));
+        runExperiment(new globals_t<CounterShardedLocked>(numThreads, millisToRun, readPercent, latencySampleEvery, numReaders));
     } else if (!strcmp(argv[3], "shard_wf")) {
-        runExperiment(new globals_t<CounterShardedWaitfree>(numThreads, millisToRun));
+        runExperiment(new globals_t<CounterShardedWaitfree>(numThreads, millisToRun, readPercent, latencySampleEvery, numReaders));
+    } else if (!strcmp(argv[3], "shard_seqlock")) {
+        runExperiment(new globals_t<CounterShardedSeqlock>(numThreads, millisToRun, readPercent, latencySampleEvery, numReaders));
+    } else if (!strcmp(argv[3], "fc")) {
+        runExperiment(new globals_t<CounterFlatCombining>(numThreads, millisToRun, readPercent, latencySampleEvery, numReaders));
+    } else if (!strcmp(argv[3], "ctree")) {
+        runExperiment(new globals_t<CounterCombiningTree>(numThreads, millisToRun, readPercent, latencySampleEvery, numReaders));
+    } else if (!strcmp(argv[3], "hier_read")) {
+        runExperiment(new globals_t<CounterHierarchical<false>>(numThreads, millisToRun, readPercent, latencySampleEvery, numReaders));
+    } else if (!strcmp(argv[3], "hier_update")) {
+        runExperiment(new globals_t<CounterHierarchical<true>>(numThreads, millisToRun, readPercent, latencySampleEvery, numReaders));
     } else {
         printf("ERROR: unexpected algorithm name %s\n", argv[3]);
         return 1;
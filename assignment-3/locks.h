@@ -0,0 +1,330 @@
+#ifndef LOCKS_H
+#define LOCKS_H
+
+// Mutual exclusion locks for any number of threads, all with the same lock()/unlock() interface
+// as mutex_t in q3_2.cpp / q3_3.cpp, so any of them can be dropped into counter_locked.
+// Like mutex_t, they identify the calling thread with the thread local variable tid,
+// which must be set (to a value in [0, MAX_THREADS)) before a thread uses a lock.
+// Only acquire/release ordering is used, except where an atomic RMW is needed anyway.
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include "numa_tools.h"
+using namespace std;
+
+#ifndef MAX_THREADS
+#define MAX_THREADS 256
+#endif
+
+#define MAX_CLUSTERS 8
+
+// statistics mode: compile with -DLOCK_STATS=if\(1\) to count full fences (including locked RMW
+// instructions, which are full fences on x86) executed by each thread
+#ifndef LOCK_STATS
+#define LOCK_STATS if(0)
+#endif
+
+__thread int tid;
+__thread int64_t fencesExecuted;
+
+inline uint64_t get_cycles() {
+#if defined(__x86_64__)
+    unsigned hi, lo;
+    __asm__ __volatile__ ("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t) lo) | (((uint64_t) hi) << 32);
+#else
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+// busy-wait helper: pause, and yield the cpu once in a while in case the thread we wait for is not running
+// (which matters for FIFO locks when there are more threads than cores)
+class SpinWait {
+private:
+    int spins = 0;
+public:
+    void wait() {
+        if ((++spins & 1023) == 0) {
+            this_thread::yield();
+        } else {
+#if defined(__x86_64__)
+            __builtin_ia32_pause();
+#endif
+        }
+    }
+};
+
+// the two-thread Dekker lock from q3_3.cpp, as a baseline (only valid for tid in {0, 1})
+class DekkerLock {
+private:
+    volatile bool wants_to_enter[2];
+    volatile int turn;
+public:
+    DekkerLock() {
+        turn = 0;
+        wants_to_enter[0] = false;
+        wants_to_enter[1] = false;
+    }
+    void lock() {
+        wants_to_enter[tid] = true;
+        __sync_synchronize();
+        LOCK_STATS ++fencesExecuted;
+        while (wants_to_enter[1 - tid]){
+            if (turn != tid){
+                __sync_synchronize();
+                wants_to_enter[tid] = false;
+                __sync_synchronize();
+                LOCK_STATS fencesExecuted += 2;
+                while (turn != tid){
+                }
+            }
+            wants_to_enter[tid] = true;
+            __sync_synchronize();
+            LOCK_STATS ++fencesExecuted;
+        }
+    }
+    void unlock() {
+        __sync_synchronize();
+        LOCK_STATS ++fencesExecuted;
+        turn = 1 - tid;
+        wants_to_enter[tid] = false;
+    }
+};
+
+// Dekker's algorithm with only the fences x86-TSO (and the C++ memory model) needs: the single
+// store-load ordering requirement is that our write to wants_to_enter[tid] becomes visible before we
+// read wants_to_enter[1-tid], so there is one seq_cst fence after each such write, and everything else
+// is acquire/release. An uncontended acquire executes exactly one fence, and release executes none.
+class DekkerLockMinFence {
+private:
+    atomic<bool> wants_to_enter[2];
+    atomic<int> turn;
+public:
+    DekkerLockMinFence() {
+        turn = 0;
+        wants_to_enter[0] = false;
+        wants_to_enter[1] = false;
+    }
+    void lock() {
+        wants_to_enter[tid].store(true, memory_order_relaxed);
+        atomic_thread_fence(memory_order_seq_cst);
+        LOCK_STATS ++fencesExecuted;
+        while (wants_to_enter[1 - tid].load(memory_order_acquire)){
+            if (turn.load(memory_order_relaxed) != tid){
+                wants_to_enter[tid].store(false, memory_order_relaxed);
+                while (turn.load(memory_order_acquire) != tid){
+                }
+                wants_to_enter[tid].store(true, memory_order_relaxed);
+                atomic_thread_fence(memory_order_seq_cst);
+                LOCK_STATS ++fencesExecuted;
+            }
+        }
+    }
+    void unlock() {
+        turn.store(1 - tid, memory_order_release);
+        wants_to_enter[tid].store(false, memory_order_release);
+    }
+};
+
+// Peterson's algorithm for two threads (tid in {0, 1}), with a single full fence per acquire,
+// between the writes to flag/victim and the read of the other thread's flag.
+// USE_XCHG == true performs the write to victim with an exchange (xchg on x86, which is implicitly
+// a full fence) instead of a plain store followed by a seq_cst fence (mfence on x86).
+template <bool USE_XCHG>
+class PetersonLock {
+private:
+    atomic<bool> flag[2];
+    atomic<int> victim;
+public:
+    PetersonLock() {
+        flag[0] = false;
+        flag[1] = false;
+        victim = 0;
+    }
+    void lock() {
+        flag[tid].store(true, memory_order_relaxed);
+        if (USE_XCHG) {
+            victim.exchange(tid, memory_order_seq_cst);
+        } else {
+            victim.store(tid, memory_order_release);
+            atomic_thread_fence(memory_order_seq_cst);
+        }
+        LOCK_STATS ++fencesExecuted;
+        // the spin can end by reading the other thread's write to victim (made after its last unlock),
+        // so both loads are acquire to synchronize with that unlock
+        while (flag[1 - tid].load(memory_order_acquire) && victim.load(memory_order_acquire) == tid){
+        }
+    }
+    void unlock() {
+        flag[tid].store(false, memory_order_release);
+    }
+};
+
+// std::mutex, as a baseline
+class StdLock {
+private:
+    std::mutex m;
+public:
+    void lock() {
+        m.lock();
+    }
+    void unlock() {
+        m.unlock();
+    }
+};
+
+// ticket lock: FIFO, one fetch&add per acquire, and every waiter spins on nowServing.
+// the lock may be released by a different thread than the one that acquired it (needed by CohortLock).
+class TicketLock {
+private:
+    char padding0[64];
+    atomic<uint32_t> nextTicket;
+    char padding1[64];
+    atomic<uint32_t> nowServing;
+    char padding2[64];
+public:
+    TicketLock() : nextTicket(0), nowServing(0) {}
+    void lock() {
+        uint32_t ticket = nextTicket.fetch_add(1, memory_order_relaxed);
+        LOCK_STATS ++fencesExecuted;
+        SpinWait sw;
+        while (nowServing.load(memory_order_acquire) != ticket) sw.wait();
+    }
+    void unlock() {
+        // only the lock holder writes nowServing, so no RMW is needed
+        nowServing.store(nowServing.load(memory_order_relaxed) + 1, memory_order_release);
+    }
+    // true if some thread is waiting to acquire the lock (only meaningful while the lock is held)
+    bool hasWaiters() {
+        return nextTicket.load(memory_order_relaxed) - nowServing.load(memory_order_relaxed) > 1;
+    }
+};
+
+// MCS queue lock: FIFO, and each waiter spins on a flag in its own queue node
+class MCSLock {
+private:
+    struct qnode {
+        atomic<qnode *> next;
+        atomic<bool> locked;
+        char padding[128 - sizeof(qnode *) - sizeof(bool)];
+    };
+    char padding0[64];
+    atomic<qnode *> tail;
+    char padding1[64];
+    qnode nodes[MAX_THREADS];
+public:
+    MCSLock() : tail(NULL) {}
+    void lock() {
+        qnode * node = &nodes[tid];
+        node->next.store(NULL, memory_order_relaxed);
+        node->locked.store(true, memory_order_relaxed);
+        qnode * pred = tail.exchange(node, memory_order_acq_rel);
+        LOCK_STATS ++fencesExecuted;
+        if (pred == NULL) return;
+        pred->next.store(node, memory_order_release);
+        SpinWait sw;
+        while (node->locked.load(memory_order_acquire)) sw.wait();
+    }
+    void unlock() {
+        qnode * node = &nodes[tid];
+        qnode * succ = node->next.load(memory_order_acquire);
+        if (succ == NULL) {
+            qnode * expected = node;
+            LOCK_STATS ++fencesExecuted;
+            if (tail.compare_exchange_strong(expected, NULL, memory_order_release, memory_order_relaxed)) return;
+            // a thread has swapped itself into tail, but has not linked itself to us yet
+            SpinWait sw;
+            while ((succ = node->next.load(memory_order_acquire)) == NULL) sw.wait();
+        }
+        succ->locked.store(false, memory_order_release);
+    }
+};
+
+// CLH queue lock: FIFO, and each waiter spins on its predecessor's node.
+// on release, a thread takes ownership of its predecessor's node for its next acquire.
+class CLHLock {
+private:
+    struct qnode {
+        atomic<bool> locked;
+        char padding[128 - sizeof(bool)];
+    };
+    char padding0[64];
+    atomic<qnode *> tail;
+    char padding1[64];
+    qnode * myNode[MAX_THREADS];
+    qnode * myPred[MAX_THREADS];
+    qnode nodes[MAX_THREADS + 1]; // one node per thread, plus the initial (unlocked) tail
+public:
+    CLHLock() {
+        for (int i = 0; i < MAX_THREADS; ++i) {
+            nodes[i].locked = false;
+            myNode[i] = &nodes[i];
+            myPred[i] = NULL;
+        }
+        nodes[MAX_THREADS].locked = false;
+        tail = &nodes[MAX_THREADS];
+    }
+    void lock() {
+        qnode * node = myNode[tid];
+        node->locked.store(true, memory_order_relaxed);
+        qnode * pred = tail.exchange(node, memory_order_acq_rel);
+        LOCK_STATS ++fencesExecuted;
+        myPred[tid] = pred;
+        SpinWait sw;
+        while (pred->locked.load(memory_order_acquire)) sw.wait();
+    }
+    void unlock() {
+        myNode[tid]->locked.store(false, memory_order_release);
+        myNode[tid] = myPred[tid];
+    }
+};
+
+// cohort lock (Dice, Marathe & Shavit): a global ticket lock plus one local ticket lock per NUMA node
+// (using the cpu/node mapping from NumaTools). when a thread releases the lock and another thread on
+// the same node is waiting, ownership of the global lock is passed to it (at most MAX_PASSES times in
+// a row, for fairness), so the lock and the data it protects tend to stay within one socket.
+class CohortLock {
+private:
+    static const int MAX_PASSES = 64;
+    struct cohort {
+        TicketLock local;
+        // the following are only accessed by the holder of the local lock
+        bool globalHeld;
+        int passes;
+        char padding[64];
+    };
+    TicketLock global;
+    cohort cohorts[MAX_CLUSTERS];
+    int myCohort[MAX_THREADS];  // cohort whose local lock thread tid holds (threads may migrate)
+    const int numClusters;
+public:
+    CohortLock() : numClusters(min(__numa.get_num_nodes(), MAX_CLUSTERS)) {
+        for (int i = 0; i < MAX_CLUSTERS; ++i) {
+            cohorts[i].globalHeld = false;
+            cohorts[i].passes = 0;
+        }
+    }
+    void lock() {
+        int c = __numa.get_node_periodic() % numClusters;
+        myCohort[tid] = c;
+        cohorts[c].local.lock();
+        if (!cohorts[c].globalHeld) global.lock();
+    }
+    void unlock() {
+        cohort & c = cohorts[myCohort[tid]];
+        if (c.local.hasWaiters() && c.passes < MAX_PASSES) {
+            // pass the global lock to the next thread in our cohort
+            ++c.passes;
+            c.globalHeld = true;
+        } else {
+            c.passes = 0;
+            c.globalHeld = false;
+            global.unlock();
+        }
+        c.local.unlock();
+    }
+};
+
+#endif /* LOCKS_H */
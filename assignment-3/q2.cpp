@@ -3,82 +3,176 @@
 #include <thread>
 #include <vector>
 #include <chrono>
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
 using namespace std;
 
+#include "numa_tools.h"
+
 #define MAX_THREADS 256
 
+// a subcounter that occupies PAD_BYTES bytes (or just the counter itself, if PAD_BYTES is 0),
+// so consecutive subcounters in an array are PAD_BYTES apart
+template <int PAD_BYTES>
 struct padded_subcounter {
     atomic<int64_t> v;
-    char padding[128 - sizeof(atomic<int64_t>)];
+    char padding[PAD_BYTES - sizeof(atomic<int64_t>)];
+};
+
+template <>
+struct padded_subcounter<0> {
+    atomic<int64_t> v;
 };
 
+// where the subcounters live:
+//  contiguous:  one array (on the node of the main thread, which first touches it), indexed by tid
+//  interleaved: one array, with its pages interleaved round-robin across all numa nodes
+//  node:        each thread allocates its own subcounter on the numa node it is running on
+enum placement_t { CONTIGUOUS, INTERLEAVED, PER_NODE };
+
+template <int PAD_BYTES>
 struct globals {
     char padding0[64];
     int numThreads;
+    placement_t placement;
     atomic<bool> start;
     atomic<bool> done;
+    atomic<int> ready;
     char padding1[64];
-    padded_subcounter subcounters[MAX_THREADS];
-    
-    globals(int _numThreads) {
+    padded_subcounter<PAD_BYTES> * array;                   // for CONTIGUOUS and INTERLEAVED
+    padded_subcounter<PAD_BYTES> * subcounters[MAX_THREADS]; // subcounter used by each thread
+    char padding2[64];
+
+    globals(int _numThreads, placement_t _placement) {
         numThreads = _numThreads;
+        placement = _placement;
         start = false;
         done = false;
+        ready = 0;
+        array = NULL;
+        const size_t size = sizeof(padded_subcounter<PAD_BYTES>) * numThreads;
+        if (placement == CONTIGUOUS) {
+            array = (padded_subcounter<PAD_BYTES> *) aligned_alloc(4096, (size + 4095) / 4096 * 4096);
+        } else if (placement == INTERLEAVED) {
+            array = (padded_subcounter<PAD_BYTES> *) numa_alloc_interleaved(size);
+        }
+        for (int i=0;i<numThreads;++i) {
+            subcounters[i] = (array == NULL) ? NULL : &array[i];
+            if (array) subcounters[i]->v = 0;
+        }
+    }
+    ~globals() {
+        const size_t size = sizeof(padded_subcounter<PAD_BYTES>) * numThreads;
+        if (placement == CONTIGUOUS) {
+            free(array);
+        } else if (placement == INTERLEAVED) {
+            numa_free(array, size);
+        } else {
+            for (int i=0;i<numThreads;++i) numa_free(subcounters[i], sizeof(padded_subcounter<PAD_BYTES>));
+        }
     }
 };
 
-globals * g;
+template <int PAD_BYTES>
+void threadFunc(int tid, globals<PAD_BYTES> * g) {
+    if (g->placement == PER_NODE) {
+        void * mem = numa_alloc_onnode(sizeof(padded_subcounter<PAD_BYTES>), __numa.get_node_slow());
+        g->subcounters[tid] = (padded_subcounter<PAD_BYTES> *) mem;
+        g->subcounters[tid]->v = 0; // first touch
+    }
+    auto sub = g->subcounters[tid];
+    g->ready++;
 
-void threadFunc(int tid) {
     // wait for all threads to be started before letting any thread do "real" work
     while (!g->start) { /* busy wait */ }
 
     // increment my subcounter until the experiment is done
     while (true) {
-        g->subcounters[tid].v++;
+        sub->v++;
         if (g->done){
-            //printf("tid: %d, increments = %ld \n", tid, g->subcounters[tid].v.load());
             break;
-        } 
+        }
     }
 }
 
-int main(int argc, char ** argv) {
-    // read command line args
-    if (argc != 3) {
-        cout<<"USAGE: "<<argv[0]<<" SECONDS_TO_RUN NUMBER_OF_THREADS"<<endl;
-        return 1;
-    }
-    int secondsToRun = atoi(argv[1]);
-    int numThreads = atoi(argv[2]);
-    
+template <int PAD_BYTES>
+void runExperiment(int secondsToRun, int numThreads, placement_t placement) {
     // initialize globals
-    g = new globals(numThreads);
-    
+    auto g = new globals<PAD_BYTES>(numThreads, placement);
+
     // create and start threads
     vector<thread *> threads;
     for (int i=0;i<g->numThreads;++i) {
-        threads.push_back(new thread(threadFunc, i));
+        threads.push_back(new thread(threadFunc<PAD_BYTES>, i, g));
     }
-    
+
     // have threads perform increments for a fixed time then stop
+    while (g->ready < g->numThreads) { /* wait for per-node allocations */ }
     g->start = true;
     this_thread::sleep_for(chrono::seconds(secondsToRun));
     g->done = true;
-    
+
     // join threads
     for (int i=0;i<g->numThreads;++i) {
         threads[i]->join();
         delete threads[i]; // free memory
     }
-    
-    // print: increments performed per second
+
+    // print: increments performed per second, in total and per thread,
+    // and the coefficient of variation (stdev / mean) of per-thread throughput
     int64_t sum = 0;
+    double sumSquares = 0;
+    cout<<"per-thread throughput (increments per second):";
     for (int i=0;i<g->numThreads;++i) {
-        sum += g->subcounters[i].v;
+        int64_t x = g->subcounters[i]->v / secondsToRun;
+        cout<<" "<<x;
+        sum += g->subcounters[i]->v;
+        sumSquares += (double) x * x;
     }
+    cout<<endl;
+    double mean = (double) sum / secondsToRun / g->numThreads;
+    double stdev = sqrt(max(0., sumSquares / g->numThreads - mean * mean));
     cout<<"throughput (increments per second)="<<(sum / secondsToRun)<<endl;
-    
+    cout<<"per-thread coefficient of variation="<<(mean > 0 ? stdev / mean : 0)<<endl;
+
     delete g; // free memory allocated for globals (and call destructor)
+}
+
+int main(int argc, char ** argv) {
+    // read command line args
+    if (argc < 3 || argc > 5) {
+        cout<<"USAGE: "<<argv[0]<<" SECONDS_TO_RUN NUMBER_OF_THREADS [PADDING_BYTES [PLACEMENT]]"<<endl;
+        cout<<"       where PADDING_BYTES in {0, 64, 128, 256} (default 128)"<<endl;
+        cout<<"       and PLACEMENT in {contiguous, interleaved, node} (default contiguous)"<<endl;
+        return 1;
+    }
+    int secondsToRun = atoi(argv[1]);
+    int numThreads = atoi(argv[2]);
+    int paddingBytes = (argc > 3) ? atoi(argv[3]) : 128;
+    placement_t placement = CONTIGUOUS;
+    if (argc > 4) {
+        if (!strcmp(argv[4], "contiguous")) placement = CONTIGUOUS;
+        else if (!strcmp(argv[4], "interleaved")) placement = INTERLEAVED;
+        else if (!strcmp(argv[4], "node")) placement = PER_NODE;
+        else {
+            cout<<"ERROR: unexpected placement "<<argv[4]<<endl;
+            return 1;
+        }
+    }
+    if (numThreads < 1 || numThreads > MAX_THREADS) {
+        cout<<"ERROR: NUMBER_OF_THREADS must be in [1, "<<MAX_THREADS<<"]"<<endl;
+        return 1;
+    }
+
+    switch (paddingBytes) {
+        case 0: runExperiment<0>(secondsToRun, numThreads, placement); break;
+        case 64: runExperiment<64>(secondsToRun, numThreads, placement); break;
+        case 128: runExperiment<128>(secondsToRun, numThreads, placement); break;
+        case 256: runExperiment<256>(secondsToRun, numThreads, placement); break;
+        default:
+            cout<<"ERROR: unsupported padding "<<paddingBytes<<endl;
+            return 1;
+    }
     return 0;
 }
@@ -0,0 +1,183 @@
+#include <iostream>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <cstring>
+#include <cmath>
+using namespace std;
+
+#include "locks.h"
+
+template <class LockType>
+class counter_locked {
+private:
+    LockType m;
+    volatile int64_t v;
+    // lock handoff statistics (LOCK_STATS mode only), protected by m
+    int lastHolder;
+    uint64_t lastReleaseCycles;
+public:
+    int64_t handoffs;
+    uint64_t handoffCycles;
+
+    counter_locked() : v(0), lastHolder(-1), lastReleaseCycles(0), handoffs(0), handoffCycles(0) {
+    }
+
+    void increment() {
+        m.lock();
+        LOCK_STATS {
+            // the lock was handed off from another thread: measure the time from its release to our acquire
+            if (lastHolder != tid && lastHolder != -1) {
+                handoffCycles += get_cycles() - lastReleaseCycles;
+                ++handoffs;
+            }
+            lastHolder = tid;
+        }
+        v = v + 1;
+        LOCK_STATS lastReleaseCycles = get_cycles();
+        m.unlock();
+    }
+
+    int64_t get() {
+        m.lock();
+        auto result = v;
+        m.unlock();
+        return result;
+    }
+};
+
+struct padded_count {
+    int64_t v;
+    char padding[128 - sizeof(int64_t)];
+};
+
+template <class LockType>
+struct globals {
+    char padding0[64];
+    int numThreads;
+    atomic<bool> start;
+    atomic<bool> done;
+    char padding1[64];
+    counter_locked<LockType> c;
+    char padding2[64];
+    padded_count increments[MAX_THREADS]; // increments performed by each thread
+    padded_count fences[MAX_THREADS];     // fences executed by each thread (LOCK_STATS mode only)
+
+    globals(int _numThreads) {
+        numThreads = _numThreads;
+        start = false;
+        done = false;
+        for (int i=0;i<MAX_THREADS;++i) increments[i].v = fences[i].v = 0;
+    }
+};
+
+template <class LockType>
+void threadFunc(int _tid, globals<LockType> * g) {
+    tid = _tid;
+    while (!g->start) { /* busy wait */ }
+
+    int64_t n = 0;
+    while (!g->done) {
+        g->c.increment();
+        ++n;
+    }
+    g->increments[tid].v = n;
+    g->fences[tid].v = fencesExecuted;
+}
+
+template <class LockType>
+void runExperiment(int secondsToRun, int numThreads) {
+    auto g = new globals<LockType>(numThreads);
+
+    vector<thread *> threads;
+    for (int i=0;i<g->numThreads;++i) {
+        threads.push_back(new thread(threadFunc<LockType>, i, g));
+    }
+
+    g->start = true;
+    this_thread::sleep_for(chrono::seconds(secondsToRun));
+    g->done = true;
+
+    for (int i=0;i<g->numThreads;++i) {
+        threads[i]->join();
+        delete threads[i];
+    }
+
+    // fairness: min/max increments per thread, and Jain's fairness index (1 = perfectly fair, 1/n = one thread did everything)
+    int64_t sum = 0;
+    int64_t minInc = g->increments[0].v;
+    int64_t maxInc = g->increments[0].v;
+    double sumSquares = 0;
+    for (int i=0;i<g->numThreads;++i) {
+        auto x = g->increments[i].v;
+        sum += x;
+        minInc = min(minInc, x);
+        maxInc = max(maxInc, x);
+        sumSquares += (double) x * x;
+    }
+    double jain = (sumSquares > 0) ? ((double) sum * sum) / (g->numThreads * sumSquares) : 1;
+
+    tid = 0;
+    auto final = g->c.get();
+    cout<<"final counter value="<<final<<((final == sum) ? " (OK)" : " (MUTUAL EXCLUSION VIOLATED)")<<endl;
+    cout<<"throughput (increments per second)="<<(sum / secondsToRun)<<endl;
+    cout<<"per-thread increments: min="<<minInc<<" max="<<maxInc<<endl;
+    cout<<"jain fairness index="<<jain<<endl;
+    LOCK_STATS {
+        int64_t totalFences = 0;
+        for (int i=0;i<g->numThreads;++i) totalFences += g->fences[i].v;
+        cout<<"fences per acquire="<<((double) totalFences / max(sum, (int64_t) 1))<<" (full fences and locked RMWs; std is not instrumented)"<<endl;
+        cout<<"lock handoffs="<<g->c.handoffs<<" cycles per handoff="<<(g->c.handoffs ? g->c.handoffCycles / g->c.handoffs : 0)<<endl;
+    }
+
+    delete g;
+}
+
+int main(int argc, char ** argv) {
+    if (argc != 4) {
+        cout<<"USAGE: "<<argv[0]<<" SECONDS_TO_RUN NUMBER_OF_THREADS LOCK_NAME"<<endl;
+        cout<<"       where LOCK_NAME in {dekker, dekker_min, peterson_fence, peterson_xchg, std, ticket, mcs, clh, cohort}"<<endl;
+        cout<<"       (dekker, dekker_min, peterson_fence and peterson_xchg require exactly 2 threads)"<<endl;
+        return 1;
+    }
+    int secondsToRun = atoi(argv[1]);
+    int numThreads = atoi(argv[2]);
+    char * lockName = argv[3];
+
+    if (numThreads < 1 || numThreads > MAX_THREADS) {
+        cout<<"ERROR: NUMBER_OF_THREADS must be in [1, "<<MAX_THREADS<<"]"<<endl;
+        return 1;
+    }
+
+    if (!strncmp(lockName, "dekker", 6) || !strncmp(lockName, "peterson", 8)) {
+        if (numThreads != 2) {
+            cout<<"ERROR: "<<lockName<<" only supports 2 threads"<<endl;
+            return 1;
+        }
+    }
+
+    if (!strcmp(lockName, "dekker")) {
+        runExperiment<DekkerLock>(secondsToRun, numThreads);
+    } else if (!strcmp(lockName, "dekker_min")) {
+        runExperiment<DekkerLockMinFence>(secondsToRun, numThreads);
+    } else if (!strcmp(lockName, "peterson_fence")) {
+        runExperiment<PetersonLock<false>>(secondsToRun, numThreads);
+    } else if (!strcmp(lockName, "peterson_xchg")) {
+        runExperiment<PetersonLock<true>>(secondsToRun, numThreads);
+    } else if (!strcmp(lockName, "std")) {
+        runExperiment<StdLock>(secondsToRun, numThreads);
+    } else if (!strcmp(lockName, "ticket")) {
+        runExperiment<TicketLock>(secondsToRun, numThreads);
+    } else if (!strcmp(lockName, "mcs")) {
+        runExperiment<MCSLock>(secondsToRun, numThreads);
+    } else if (!strcmp(lockName, "clh")) {
+        runExperiment<CLHLock>(secondsToRun, numThreads);
+    } else if (!strcmp(lockName, "cohort")) {
+        runExperiment<CohortLock>(secondsToRun, numThreads);
+    } else {
+        cout<<"ERROR: unexpected lock name "<<lockName<<endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,159 @@
+#pragma once
+#include "util.h"
+#include <atomic>
+#include <mutex>
+#include <cstdlib>
+#include <algorithm>
+using namespace std;
+
+// a mutex alone on its cache line(s)
+struct PADDED_MUTEX {
+    std::mutex m;
+    char padding[PADDING_BYTES-sizeof(std::mutex)];
+};
+
+/**
+ * compact layout for lock-based linear probing: keys are packed densely (KEYS_PER_LOCK keys per 64-byte line),
+ * and one lock guards each group of KEYS_PER_LOCK consecutive buckets. the locks live in a separate padded array,
+ * so taking a lock never invalidates the line holding the keys that readers are probing.
+ * a table of N keys uses 4*N + PADDING_BYTES*N/KEYS_PER_LOCK bytes (12*N bytes with 128 byte padding),
+ * instead of 128*N bytes for an array of BUCKET.
+ */
+struct STRIPED_BUCKETS {
+    static constexpr int KEYS_PER_LOCK = 64 / sizeof(int);
+
+    int64_t capacity;
+    int64_t numLocks;
+    volatile int * keys;
+    PADDED_MUTEX * locks;
+
+    STRIPED_BUCKETS(int64_t _capacity) : capacity(_capacity) {
+        numLocks = (capacity + KEYS_PER_LOCK - 1) / KEYS_PER_LOCK;
+        keys = (volatile int *) aligned_alloc(64, numLocks * 64); // whole lines, so no group straddles two lines
+        for (int64_t i=0;i<numLocks*KEYS_PER_LOCK;++i) keys[i] = 0;
+        locks = new PADDED_MUTEX[numLocks];
+    }
+    ~STRIPED_BUCKETS() {
+        free((void *) keys);
+        delete[] locks;
+    }
+
+    std::mutex & lockFor(int64_t index) { return locks[index / KEYS_PER_LOCK].m; }
+
+    // one past the last index guarded by the same lock as index
+    int64_t groupEnd(int64_t index) { return min(capacity, (index / KEYS_PER_LOCK + 1) * KEYS_PER_LOCK); }
+
+    void lockAll() { for (int64_t i=0;i<numLocks;++i) locks[i].m.lock(); }
+    void unlockAll() { for (int64_t i=0;i<numLocks;++i) locks[i].m.unlock(); }
+};
+
+// AlgorithmA with STRIPED_BUCKETS: each probe takes the lock of a group once, then scans the rest of the group under it
+class AlgorithmAStriped {
+public:
+
+    static constexpr int TOMBSTONE = -1;
+
+    char padding0[PADDING_BYTES];
+    const int numThreads;
+    int capacity;
+    char padding2[PADDING_BYTES];
+
+    STRIPED_BUCKETS * data;
+
+    AlgorithmAStriped(const int _numThreads, const int _capacity);
+    ~AlgorithmAStriped();
+    bool insertIfAbsent(const int tid, const int & key);
+    bool erase(const int tid, const int & key);
+    long getSumOfKeys();
+    void printDebuggingDetails();
+};
+
+/**
+ * constructor: initialize the hash table's internals
+ *
+ * @param _numThreads maximum number of threads that will ever use the hash table (i.e., at least tid+1, where tid is the largest thread ID passed to any function of this class)
+ * @param _capacity is the INITIAL size of the hash table (maximum number of elements it can contain WITHOUT expansion)
+ */
+AlgorithmAStriped::AlgorithmAStriped(const int _numThreads, const int _capacity)
+: numThreads(_numThreads), capacity(_capacity) {
+    data = new STRIPED_BUCKETS(capacity);
+}
+
+// destructor: clean up any allocated memory, etc.
+AlgorithmAStriped::~AlgorithmAStriped() {
+    delete data;
+}
+
+// semantics: try to insert key. return true if successful (if key doesn't already exist), and false otherwise
+bool AlgorithmAStriped::insertIfAbsent(const int tid, const int & key) {
+
+    int64_t index = murmur3(key) % capacity;
+    for(int64_t i = 0; i < capacity; ){
+
+        std::mutex & m = data->lockFor(index);
+        m.lock();
+        for(int64_t end = data->groupEnd(index); index < end && i < capacity; ++index, ++i){
+            int found = data->keys[index];
+
+            if (found == key){
+                m.unlock();
+                return false;
+            }
+            else if (found == 0){
+                data->keys[index] = key;
+                m.unlock();
+                return true;
+            }
+        }
+        m.unlock();
+        if (index == capacity) index = 0;
+    }
+    return false;
+}
+
+// semantics: try to erase key. return true if successful, and false otherwise
+bool AlgorithmAStriped::erase(const int tid, const int & key) {
+
+    int64_t index = murmur3(key) % capacity;
+    for(int64_t i = 0; i < capacity; ){
+
+        std::mutex & m = data->lockFor(index);
+        m.lock();
+        for(int64_t end = data->groupEnd(index); index < end && i < capacity; ++index, ++i){
+            int found = data->keys[index];
+            if (found == 0){
+                m.unlock();
+                return false;
+            }
+            else if (found == key){
+                data->keys[index] = TOMBSTONE;
+                m.unlock();
+                return true;
+            }
+        }
+        m.unlock();
+        if (index == capacity) index = 0;
+    }
+    return false;
+}
+
+// semantics: return the sum of all KEYS in the set
+int64_t AlgorithmAStriped::getSumOfKeys() {
+
+    int64_t sum = 0;
+
+    data->lockAll();
+    for(int index = 0; index < capacity; ++index){
+        int found = data->keys[index];
+        if (found > 0){
+            sum += found;
+        }
+    }
+    data->unlockAll();
+    return sum;
+}
+
+// print any debugging details you want at the end of a trial in this function
+void AlgorithmAStriped::printDebuggingDetails() {
+
+}
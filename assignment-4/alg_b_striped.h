@@ -0,0 +1,128 @@
+#pragma once
+#include "util.h"
+#include "alg_a_striped.h"
+#include <atomic>
+#include <mutex>
+using namespace std;
+
+// AlgorithmB with STRIPED_BUCKETS (see alg_a_striped.h): probes read keys without locking,
+// and only the group containing the bucket to be written is locked (then the bucket is re-read under the lock)
+class AlgorithmBStriped {
+public:
+    static constexpr int TOMBSTONE = -1;
+
+    char padding0[PADDING_BYTES];
+    const int numThreads;
+    int capacity;
+    char padding2[PADDING_BYTES];
+
+    STRIPED_BUCKETS * data;
+
+    AlgorithmBStriped(const int _numThreads, const int _capacity);
+    ~AlgorithmBStriped();
+    bool insertIfAbsent(const int tid, const int & key);
+    bool erase(const int tid, const int & key);
+    long getSumOfKeys();
+    void printDebuggingDetails();
+};
+
+/**
+ * constructor: initialize the hash table's internals
+ *
+ * @param _numThreads maximum number of threads that will ever use the hash table (i.e., at least tid+1, where tid is the largest thread ID passed to any function of this class)
+ * @param _capacity is the INITIAL size of the hash table (maximum number of elements it can contain WITHOUT expansion)
+ */
+AlgorithmBStriped::AlgorithmBStriped(const int _numThreads, const int _capacity)
+: numThreads(_numThreads), capacity(_capacity) {
+    data = new STRIPED_BUCKETS(capacity);
+}
+
+// destructor: clean up any allocated memory, etc.
+AlgorithmBStriped::~AlgorithmBStriped() {
+    delete data;
+}
+
+// semantics: try to insert key. return true if successful (if key doesn't already exist), and false otherwise
+bool AlgorithmBStriped::insertIfAbsent(const int tid, const int & key) {
+
+    uint32_t h = murmur3(key);
+    for(uint32_t i = 0; i < capacity; ++i){
+
+        uint32_t index = (h + i) % capacity;
+        int found = data->keys[index];
+
+        if (found == key){
+            return false; //LP is last read of data->keys[index]
+        }
+        else if (found == 0){
+            std::mutex & m = data->lockFor(index);
+            m.lock();
+            found = data->keys[index];
+            if (found == 0){
+                data->keys[index] = key;
+                m.unlock();
+                return true; //LP is write to data->keys[index]
+            }
+            if (found == key){
+                m.unlock();
+                return false; //LP is last read of data->keys[index]
+            }
+            m.unlock();
+        }
+
+    }
+    return false; //LP is last read of data->keys[index]
+}
+
+// semantics: try to erase key. return true if successful, and false otherwise
+bool AlgorithmBStriped::erase(const int tid, const int & key) {
+
+    uint32_t h = murmur3(key);
+
+    for(uint32_t i = 0; i < capacity; ++i){
+
+        uint32_t index = (h + i) % capacity;
+        int found = data->keys[index];
+        if (found == 0){
+            return false; //LP is the last read of data->keys[index]
+        }
+        else if(found == key){
+            std::mutex & m = data->lockFor(index);
+            m.lock();
+            found = data->keys[index];
+            if (found == key){
+                data->keys[index] = TOMBSTONE;
+                m.unlock();
+                return true; //LP is write to data->keys[index]
+            }
+            if(found == TOMBSTONE){
+                m.unlock();
+                return false; //LP is the last read of data->keys[index]
+            }
+            m.unlock();
+        }
+
+    }
+    return false; //LP is the last read of data->keys[index]
+}
+
+// semantics: return the sum of all KEYS in the set
+int64_t AlgorithmBStriped::getSumOfKeys() {
+
+    int64_t sum = 0;
+
+    data->lockAll();
+    for(int index = 0; index < capacity; ++index){
+        int found = data->keys[index];
+        if (found > 0){
+            sum += found;
+        }
+    }
+    data->unlockAll();
+    return sum;
+}
+
+// print any debugging details you want at the end of a trial in this function
+void AlgorithmBStriped::printDebuggingDetails() {
+
+}
@@ -2,12 +2,14 @@
 #include "util.h"
 #include <atomic>
 #include <cassert>
+#include <vector>
 using namespace std;
 
 struct ATOMIC_BUCKET {
     atomic<int> key;
 };
 
+template <class HashFunction = murmur3_hash_t>
 class AlgorithmC {
 public:
     static constexpr int TOMBSTONE = -1;
@@ -23,8 +25,20 @@ public:
     ~AlgorithmC();
     bool insertIfAbsent(const int tid, const int & key);
     bool erase(const int tid, const int & key);
+    bool contains(const int tid, const int & key);
+    // batched versions: results[i] is the result of the operation on keys[i] (see runBatch in util.h)
+    void insertBatch(const int tid, const int * keys, const int n, bool * results);
+    void eraseBatch(const int tid, const int * keys, const int n, bool * results);
+    void containsBatch(const int tid, const int * keys, const int n, bool * results);
     long getSumOfKeys();
     void printDebuggingDetails(); 
+    // histogram[p] += number of keys with probe length p (buckets read to find the key). not thread safe.
+    void addProbeLengths(vector<int64_t> & histogram);
+
+private:
+    bool insertHashed(const int tid, const int & key, uint32_t h);
+    bool eraseHashed(const int tid, const int & key, uint32_t h);
+    bool containsHashed(const int tid, const int & key, uint32_t h);
 };
 
 /**
@@ -33,7 +47,8 @@ public:
  * @param _numThreads maximum number of threads that will ever use the hash table (i.e., at least tid+1, where tid is the largest thread ID passed to any function of this class)
  * @param _capacity is the INITIAL size of the hash table (maximum number of elements it can contain WITHOUT expansion)
  */
-AlgorithmC::AlgorithmC(const int _numThreads, const int _capacity)
+template <class HashFunction>
+AlgorithmC<HashFunction>::AlgorithmC(const int _numThreads, const int _capacity)
 : numThreads(_numThreads), capacity(_capacity) {
 
     data = new ATOMIC_BUCKET[capacity];
@@ -44,14 +59,19 @@ AlgorithmC::AlgorithmC(const int _numThreads, const int _capacity)
 }
 
 // destructor: clean up any allocated memory, etc.
-AlgorithmC::~AlgorithmC() {
+template <class HashFunction>
+AlgorithmC<HashFunction>::~AlgorithmC() {
     delete [] data;
 }
 
 // semantics: try to insert key. return true if successful (if key doesn't already exist), and false otherwise
-bool AlgorithmC::insertIfAbsent(const int tid, const int & key) {
-    
-    uint32_t h = murmur3(key);
+template <class HashFunction>
+bool AlgorithmC<HashFunction>::insertIfAbsent(const int tid, const int & key) {
+    return insertHashed(tid, key, HashFunction::hash(key));
+}
+
+template <class HashFunction>
+bool AlgorithmC<HashFunction>::insertHashed(const int tid, const int & key, uint32_t h) {
     for(uint32_t i = 0; i < capacity; ++i){
 
         uint32_t index = (h + i) % capacity;
@@ -74,10 +94,13 @@ bool AlgorithmC::insertIfAbsent(const int tid, const int & key) {
 }
 
 // semantics: try to erase key. return true if successful, and false otherwise
-bool AlgorithmC::erase(const int tid, const int & key) {
-
+template <class HashFunction>
+bool AlgorithmC<HashFunction>::erase(const int tid, const int & key) {
+    return eraseHashed(tid, key, HashFunction::hash(key));
+}
 
-    uint32_t h = murmur3(key);
+template <class HashFunction>
+bool AlgorithmC<HashFunction>::eraseHashed(const int tid, const int & key, uint32_t h) {
     for(uint32_t i = 0; i < capacity; ++i){
 
         uint32_t index = (h + i) % capacity;
@@ -92,8 +115,52 @@ bool AlgorithmC::erase(const int tid, const int & key) {
     return false;
 }
 
+// semantics: return true if key is in the set, and false otherwise
+template <class HashFunction>
+bool AlgorithmC<HashFunction>::contains(const int tid, const int & key) {
+    return containsHashed(tid, key, HashFunction::hash(key));
+}
+
+template <class HashFunction>
+bool AlgorithmC<HashFunction>::containsHashed(const int tid, const int & key, uint32_t h) {
+    for(uint32_t i = 0; i < capacity; ++i){
+
+        uint32_t index = (h + i) % capacity;
+        int found = data[index].key;
+        if (found == 0){
+            return false;
+        }
+        else if(found == key){
+            return true;
+        }
+    }
+    return false;
+}
+
+template <class HashFunction>
+void AlgorithmC<HashFunction>::insertBatch(const int tid, const int * keys, const int n, bool * results) {
+    runBatch<HashFunction>(keys, n, results,
+            [&](uint32_t h) { __builtin_prefetch(&data[h % capacity], 1); },
+            [&](int key, uint32_t h) { return insertHashed(tid, key, h); });
+}
+
+template <class HashFunction>
+void AlgorithmC<HashFunction>::eraseBatch(const int tid, const int * keys, const int n, bool * results) {
+    runBatch<HashFunction>(keys, n, results,
+            [&](uint32_t h) { __builtin_prefetch(&data[h % capacity], 1); },
+            [&](int key, uint32_t h) { return eraseHashed(tid, key, h); });
+}
+
+template <class HashFunction>
+void AlgorithmC<HashFunction>::containsBatch(const int tid, const int * keys, const int n, bool * results) {
+    runBatch<HashFunction>(keys, n, results,
+            [&](uint32_t h) { __builtin_prefetch(&data[h % capacity], 0); },
+            [&](int key, uint32_t h) { return containsHashed(tid, key, h); });
+}
+
 // semantics: return the sum of all KEYS in the set
-int64_t AlgorithmC::getSumOfKeys() {
+template <class HashFunction>
+int64_t AlgorithmC<HashFunction>::getSumOfKeys() {
     int64_t sum = 0;
     for(int index = 0; index < capacity; ++index){
         int found = data[index].key;
@@ -104,7 +171,20 @@ int64_t AlgorithmC::getSumOfKeys() {
     return sum;
 }
 
+template <class HashFunction>
+void AlgorithmC<HashFunction>::addProbeLengths(vector<int64_t> & histogram) {
+    for(int64_t index = 0; index < capacity; ++index){
+        int found = data[index].key;
+        if (found > 0){
+            size_t probeLength = 1 + (index - HashFunction::hash(found) % capacity + capacity) % capacity;
+            if (histogram.size() <= probeLength) histogram.resize(probeLength + 1);
+            ++histogram[probeLength];
+        }
+    }
+}
+
 // print any debugging details you want at the end of a trial in this function
-void AlgorithmC::printDebuggingDetails() {
+template <class HashFunction>
+void AlgorithmC<HashFunction>::printDebuggingDetails() {
     
 }
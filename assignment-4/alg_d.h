@@ -1,61 +1,104 @@
 #pragma once
 #include "util.h"
+#include "recordmgr/record_manager.h"   // from assignment-5 (see Makefile)
+#include "resize_policy.h"              // from assignment-7/common
+#include "table_storage.h"
 #include <atomic>
 #include <cassert>
 #include <cmath>
 #include <stdlib.h>
+#include <omp.h>
+#include <vector>
 using namespace std;
 
 
+/**
+ * Expansion is non-blocking and incremental: when a new table is installed, the buckets of the old table
+ * are migrated in chunks of CHUNK_SIZE buckets, and no operation ever waits for another thread's migration.
+ * Before an operation on key k uses the new table, it migrates (or helps migrate) the chunks of the old table
+ * that k's probe sequence passes through, so if k is in the old table, it is in the new table afterwards.
+ * Each operation also migrates one more unclaimed chunk, so the migration finishes even for untouched chunks.
+ *
+ * Migrating a bucket marks it (so it can no longer change), and then inserts its key into the new table.
+ * Several threads may migrate the same chunk concurrently, and a slow thread may re-insert a key long after it
+ * was migrated, so migration inserts must be idempotent. This is why erase does not replace a key with a
+ * tombstone, but sets the DELETED bit of the bucket: a bucket holds the same key forever once a key is written,
+ * so a late migration insert of k finds k's bucket (deleted or not) and does nothing.
+ * (Re-inserting an erased key clears its DELETED bit in place.)
+ *
+ * Resizing follows a resize_policy_t, which distinguishes live keys from used buckets (live + deleted):
+ * the table is rebuilt when too many buckets are used (growing, shrinking or keeping its capacity, depending on
+ * how many of the used buckets are live), and shrunk when too few keys are live. A rebuild at the same capacity
+ * is how deleted buckets are cleaned up (it cannot be done in place, since the table is lock-free).
+ *
+ * forEachKey, sumKeys and countKeys can run concurrently with updates and expansion, and scan the table in
+ * CHUNK_SIZE chunks on several threads. They are weakly consistent: they see every key that is in the set for
+ * the whole scan exactly once, never see a key twice, and may or may not see keys inserted or erased during the scan.
+ * (The scan finishes any migration into the current table t, then reads t's buckets. Every key in the set when
+ * the scan starts is then in exactly one bucket of t, and if t is replaced during the scan, its buckets are
+ * frozen, which only hides later updates. t cannot be freed during the scan, since the caller holds a guard.)
+ *
+ * Bucket arrays are mmapped (see table_storage.h), so they need no zeroing. The initial table's pages are
+ * faulted in by a team of threads, and the pages of a table created by an expansion are faulted in lazily by
+ * the threads that migrate into it.
+ */
+template <class HashFunction = murmur3_hash_t>
 class AlgorithmD {
 
 private:
     enum {
-        MARKED_MASK = (int) 0x80000000,     // most significant bit of a 32-bit key
-        TOMBSTONE = (int) 0x7FFFFFFF,       // largest value that doesn't use bit MARKED_MASK
+        MARKED_MASK = (int) 0x80000000,     // most significant bit of a 32-bit key: bucket is frozen for migration
+        DELETED_MASK = (int) 0x40000000,    // second most significant bit: key was erased
         EMPTY = (int) 0
-    }; // with these definitions, the largest "real" key we allow in the table is 0x7FFFFFFE, and the smallest is 1 !!
+    }; // with these definitions, the largest "real" key we allow in the table is 0x3FFFFFFF, and the smallest is 1 !!
+    static const int CHUNK_SIZE = 4096;     // number of buckets migrated at a time
 
+    // a table owns its currData. when a table t is replaced, t->currData becomes the new table's oldData,
+    // so t is retired (with its currData and counters) only once the new table's migration is finished,
+    // and is freed by the epoch based reclaimer once no thread can still be accessing it.
     struct table {
         // data types
         char padding0[PADDING_BYTES];
+        table * prev;                       // table we migrate from (NULL once it has been retired)
         ATOMIC_BUCKET * oldData;
         ATOMIC_BUCKET * currData;
+        size_t currDataBytes;               // length of currData's mapping
         int currCapacity;
         int oldCapacity;
-        counter * insertAC;
+        int totalOldChunks;
+        atomic<bool> * chunkMigrated;       // per chunk of oldData: has every bucket in it been migrated?
+        counter * insertAC;                 // successful inserts (live keys = inserts - deletes)
         counter * deleteAC;
+        counter * slotsAC;                  // buckets that went from EMPTY to holding a key (used buckets)
         char padding1[PADDING_BYTES];
         atomic<int> chunksClaimed;
         char padding2[PADDING_BYTES];
         atomic<int> chunksDone;
         char padding3[PADDING_BYTES];
 
-        // constructor
-        table(int oldC, ATOMIC_BUCKET * oldD, int currC, int nThreads){
+        // constructor (touchThreads as in allocTableStorage)
+        table(table * _prev, int currC, int nThreads, const table_storage_t & storage, int touchThreads){
 
-            oldData = oldD;
-            oldCapacity = oldC;
+            prev = _prev;
+            oldData = prev ? prev->currData : NULL;
+            oldCapacity = prev ? prev->currCapacity : 0;
+            totalOldChunks = (oldCapacity + CHUNK_SIZE - 1) / CHUNK_SIZE;
 
-            currCapacity = currC;            
-            try{
-                currData = new ATOMIC_BUCKET[currCapacity];
-            }
-            catch(std::bad_alloc & ba){
-                cout << "BAD ALLOC ****************** CAUGHT" << endl;
-                cout << "New Capacity at BAD ALLOC:   " << currCapacity << endl;
-                exit(3);
-            }
-            
-            for(int i = 0; i < currCapacity; ++i){
-                currData[i].key.store(0, std::memory_order_relaxed);
+            currCapacity = currC;
+            // all zero bits is EMPTY, so the (zeroed) mapping is an array of empty buckets
+            static_assert(EMPTY == 0 && sizeof(ATOMIC_BUCKET) == sizeof(int), "buckets must be plain zeroed ints");
+            currData = (ATOMIC_BUCKET *) allocTableStorage(currCapacity * sizeof(ATOMIC_BUCKET), storage, touchThreads, &currDataBytes);
+
+            chunkMigrated = new atomic<bool>[totalOldChunks];
+            for(int i = 0; i < totalOldChunks; ++i){
+                chunkMigrated[i].store(false, std::memory_order_relaxed);
             }
-            
             insertAC = new counter(nThreads);
             deleteAC = new counter(nThreads);
+            slotsAC = new counter(nThreads);
             chunksClaimed = ATOMIC_VAR_INIT(0);
             chunksDone = ATOMIC_VAR_INIT(0);
-            
+
         }
 
         // destructor
@@ -63,206 +106,425 @@ private:
         ~table(){
             delete insertAC;
             delete deleteAC;
-            delete[] currData;
+            delete slotsAC;
+            delete[] chunkMigrated;
+            freeTableStorage(currData, currDataBytes);
         }
-        
+
     };
 
     //New helper functions added
     int getKey(int key);
     bool isMarked(int key);
-    int64_t getSumOld();
+    bool isDeleted(int key);
 
+    bool insertInternal(const int tid, const int & key, uint32_t h);
+    bool eraseInternal(const int tid, const int & key, uint32_t h);
+    bool containsInternal(const int tid, const int & key, uint32_t h);
     bool expandAsNeeded(const int tid, table * t, int i);
-    void helpExpansion(const int tid, table * t);
-    void startExpansion(const int tid, table * t);
-    void migrate(const int tid, table * t, int myChunk);
-    
+    bool shrinkAsNeeded(const int tid, table * t);
+    void helpExpansion(const int tid, table * t, uint32_t h);
+    void finishExpansion(const int tid, table * t);
+    bool startExpansion(const int tid, table * t);
+    void migrateChunk(const int tid, table * t, int myChunk);
+    void migrateBucket(const int tid, table * t, int index);
+    void insertMigrated(const int tid, table * t, int key);
+    int bulkPlace(ATOMIC_BUCKET * data, int64_t capacity, int key, int64_t home, int64_t end);
+    template <class ChunkVisitor>
+    void forEachChunk(const int tid, const int numScanThreads, ChunkVisitor visitChunk);
+
     char padding0[PADDING_BYTES];
     int numThreads;
     int initCapacity;
+    resize_policy_t policy;
+    table_storage_t storage;
     // more fields (pad as appropriate)
     atomic<table *> currentTable;
     char padding1[PADDING_BYTES];
-    
+    simple_record_manager<table> * recmgr; // epoch based reclamation (DEBRA) of replaced tables
+    char padding2[PADDING_BYTES];
+    atomic<int64_t> numResizes[RESIZE_CLEANUP+1]; // number of rebuilds of each kind (indexed by resize_action_t)
+    char padding3[PADDING_BYTES];
+
 public:
-    AlgorithmD(const int _numThreads, const int _capacity);
+    AlgorithmD(const int _numThreads, const int _capacity, const resize_policy_t & _policy = resize_policy_t(),
+            const table_storage_t & _storage = table_storage_t());
+    AlgorithmD(const int _numThreads, const vector<int> & keys, const resize_policy_t & _policy = resize_policy_t(),
+            const table_storage_t & _storage = table_storage_t(), int numLoadThreads = 0);
     ~AlgorithmD();
-    bool insertIfAbsent(const int tid, const int & key, bool disableExpansion);
+    bool insertIfAbsent(const int tid, const int & key);
     bool erase(const int tid, const int & key);
+    bool contains(const int tid, const int & key);
+    // batched versions: results[i] is the result of the operation on keys[i] (see runBatch in util.h)
+    void insertBatch(const int tid, const int * keys, const int n, bool * results);
+    void eraseBatch(const int tid, const int * keys, const int n, bool * results);
+    void containsBatch(const int tid, const int * keys, const int n, bool * results);
     long getSumOfKeys();
-    void printDebuggingDetails(); 
+    void printDebuggingDetails();
+    // histogram[p] += number of live keys with probe length p (buckets read to find the key) in the current table.
+    // not thread safe.
+    void addProbeLengths(vector<int64_t> & histogram);
+    int64_t getCapacity() { return currentTable.load()->currCapacity; }
+
+    // weakly consistent scans (see above) that can run concurrently with updates, using numScanThreads threads.
+    // visit(key) is called for every key seen, concurrently from several threads if numScanThreads > 1.
+    template <class Visitor>
+    void forEachKey(const int tid, Visitor visit, const int numScanThreads = 1);
+    int64_t sumKeys(const int tid, const int numScanThreads = 1);
+    int64_t countKeys(const int tid, const int numScanThreads = 1);
 };
 
 /**
  * constructor: initialize the hash table's internals
- * 
+ *
  * @param _numThreads maximum number of threads that will ever use the hash table (i.e., at least tid+1, where tid is the largest thread ID passed to any function of this class)
  * @param _capacity is the INITIAL size of the hash table (maximum number of elements it can contain WITHOUT expansion)
+ * @param _policy determines when the table is grown, shrunk or cleaned up (its minCapacity defaults to _capacity)
+ * @param _storage determines how bucket arrays are allocated (the initial one is touched by omp_get_max_threads() threads)
  */
-AlgorithmD::AlgorithmD(const int _numThreads, const int _capacity)
-: numThreads(_numThreads), initCapacity(_capacity) {
-    currentTable = new table(0, NULL, _capacity, _numThreads);
+template <class HashFunction>
+AlgorithmD<HashFunction>::AlgorithmD(const int _numThreads, const int _capacity, const resize_policy_t & _policy, const table_storage_t & _storage)
+: numThreads(_numThreads), initCapacity(_capacity), policy(_policy), storage(_storage) {
+    if (policy.minCapacity == 0) policy.minCapacity = _capacity;
+    for (auto & n : numResizes) n = 0;
+    recmgr = new simple_record_manager<table>(MAX_THREADS);
+    currentTable = new table(NULL, _capacity, _numThreads, storage, omp_get_max_threads());
+}
+
+/**
+ * bulk load constructor: build the table from keys (sorted or not, possibly with duplicates) in parallel,
+ * without any CAS. the initial capacity is the one the resize policy picks for keys.size() keys.
+ *
+ * the buckets are split into regions, and the keys are grouped by the region of their home bucket
+ * (with a parallel counting sort). each region is then filled by one thread, which probes from a key's home
+ * bucket but stops at the end of the region, so no two threads write the same bucket and plain stores suffice.
+ * keys whose probe sequence would leave their region are placed afterwards by one thread.
+ * (a key can be found as long as no bucket between its home bucket and its own bucket is empty,
+ * and buckets are only ever filled, so both passes preserve this.)
+ *
+ * @param keys the keys to load (each in [1, 0x3FFFFFFF])
+ * @param numLoadThreads number of OpenMP threads that load the keys (0 means omp_get_max_threads())
+ */
+template <class HashFunction>
+AlgorithmD<HashFunction>::AlgorithmD(const int _numThreads, const vector<int> & keys, const resize_policy_t & _policy,
+        const table_storage_t & _storage, int numLoadThreads)
+: numThreads(_numThreads), policy(_policy), storage(_storage) {
+    if (numLoadThreads <= 0) numLoadThreads = omp_get_max_threads();
+    const int64_t numKeys = keys.size();
+    const int64_t capacity = policy.getNewCapacity(numKeys);
+    assert(capacity <= 0x7FFFFFFF);
+    initCapacity = capacity;
+    if (policy.minCapacity == 0) policy.minCapacity = capacity;
+    for (auto & n : numResizes) n = 0;
+    recmgr = new simple_record_manager<table>(MAX_THREADS);
+    table * t = new table(NULL, capacity, _numThreads, storage, numLoadThreads);
+    ATOMIC_BUCKET * data = t->currData;
+
+    const int64_t regionSize = max((int64_t) CHUNK_SIZE, capacity / (16 * numLoadThreads) + 1);
+    const int64_t numRegions = (capacity + regionSize - 1) / regionSize;
+    vector<int64_t> regionStart(numRegions + 1);    // the keys of region r are grouped[regionStart[r] .. regionStart[r+1])
+    vector<int> grouped(numKeys);
+    vector<int64_t> offsets;                        // offsets[thread * numRegions + r]: where thread puts its next key of region r
+    vector<int> overflow;
+    int64_t placed = 0;
+
+    #pragma omp parallel num_threads(numLoadThreads)
+    {
+        const int64_t me = omp_get_thread_num();
+        const int64_t teamSize = omp_get_num_threads();
+        #pragma omp single
+        offsets.assign(teamSize * numRegions, 0);
+        int64_t * myOffsets = &offsets[me * numRegions];
+
+        // count the keys of each region (both loops have the same static schedule, so each thread
+        // scatters exactly the keys it counted)
+        #pragma omp for schedule(static)
+        for (int64_t i = 0; i < numKeys; ++i) {
+            assert(keys[i] > 0 && getKey(keys[i]) == keys[i]);
+            ++myOffsets[HashFunction::hash(keys[i]) % capacity / regionSize];
+        }
+        #pragma omp single
+        {
+            int64_t offset = 0;
+            for (int64_t r = 0; r < numRegions; ++r) {
+                regionStart[r] = offset;
+                for (int64_t thread = 0; thread < teamSize; ++thread) {
+                    int64_t count = offsets[thread * numRegions + r];
+                    offsets[thread * numRegions + r] = offset;
+                    offset += count;
+                }
+            }
+            regionStart[numRegions] = offset;
+        }
+        #pragma omp for schedule(static)
+        for (int64_t i = 0; i < numKeys; ++i) {
+            grouped[myOffsets[HashFunction::hash(keys[i]) % capacity / regionSize]++] = keys[i];
+        }
+
+        // fill each region
+        vector<int> myOverflow;
+        int64_t myPlaced = 0;
+        #pragma omp for schedule(dynamic, 1)
+        for (int64_t r = 0; r < numRegions; ++r) {
+            const int64_t regionEnd = min(capacity, (r + 1) * regionSize);
+            for (int64_t i = regionStart[r]; i < regionStart[r + 1]; ++i) {
+                int result = bulkPlace(data, capacity, grouped[i], HashFunction::hash(grouped[i]) % capacity, regionEnd);
+                if (result < 0) myOverflow.push_back(grouped[i]);
+                else myPlaced += result;
+            }
+        }
+        #pragma omp critical
+        {
+            overflow.insert(overflow.end(), myOverflow.begin(), myOverflow.end());
+            placed += myPlaced;
+        }
+    }
+
+    for (int key : overflow) {
+        int64_t home = HashFunction::hash(key) % capacity;
+        int result = bulkPlace(data, capacity, key, home, home + capacity);
+        assert(result >= 0);
+        placed += result;
+    }
+    t->insertAC->add(placed);
+    t->slotsAC->add(placed);
+    currentTable = t;
 }
 
 
 // destructor: clean up any allocated memory, etc.
-AlgorithmD::~AlgorithmD() {
-    //delete currentTable.load()->oldData;
-    delete currentTable;
+template <class HashFunction>
+AlgorithmD<HashFunction>::~AlgorithmD() {
+    table * t = currentTable.load();
+    if (t->prev) delete t->prev; // migration into t was never finished
+    delete t;
+    delete recmgr; // frees all retired tables
 }
 
-int AlgorithmD::getKey(int key){
-    return key & (~MARKED_MASK);
+template <class HashFunction>
+int AlgorithmD<HashFunction>::getKey(int key){
+    return key & ~(MARKED_MASK | DELETED_MASK);
 }
 
-bool AlgorithmD::isMarked(int key){
+template <class HashFunction>
+bool AlgorithmD<HashFunction>::isMarked(int key){
     if((key & MARKED_MASK) == MARKED_MASK){
         return true;
     }
     return false;
 }
 
-bool AlgorithmD::expandAsNeeded(const int tid, table * t, int i) {
-    helpExpansion(tid, t);
-    if(((t->insertAC->get()) > t->currCapacity / 2) || (i > 50 && t->insertAC->getAccurate() > t->currCapacity / 2)){
-        startExpansion(tid, t);
-        return true;
+template <class HashFunction>
+bool AlgorithmD<HashFunction>::isDeleted(int key){
+    return (key & DELETED_MASK) == DELETED_MASK;
+}
+
+// called on every probe: rebuild t if too many of its buckets are used
+template <class HashFunction>
+bool AlgorithmD<HashFunction>::expandAsNeeded(const int tid, table * t, int i) {
+    const double maxUsed = policy.maxLoadFactor * t->currCapacity;
+    if((t->slotsAC->get() > maxUsed) || (i > 50 && t->slotsAC->getAccurate() > maxUsed)){
+        return startExpansion(tid, t);
     }
     return false;
 }
 
-void AlgorithmD::helpExpansion(const int tid, table * t) {
+// called after an erase flushes its deleteAC subcounter (so the accurate counts are read rarely): shrink t if too few keys are live
+template <class HashFunction>
+bool AlgorithmD<HashFunction>::shrinkAsNeeded(const int tid, table * t) {
+    const int64_t live = t->insertAC->get() - t->deleteAC->get();
+    if (live < policy.minLoadFactor * t->currCapacity && t->currCapacity > policy.minCapacity) {
+        return startExpansion(tid, t);
+    }
+    return false;
+}
 
-    int totalOldChunks = ceil((float)t->oldCapacity / 4096);
-    while (t->chunksClaimed < totalOldChunks){
+// called at the start of every operation on t, with the hash of the operation's key:
+// migrate one unclaimed chunk, then every chunk that the key's probe sequence in the old table passes through
+template <class HashFunction>
+void AlgorithmD<HashFunction>::helpExpansion(const int tid, table * t, uint32_t h) {
+    if (t->chunksDone == t->totalOldChunks) return;
+
+    if (t->chunksClaimed < t->totalOldChunks) {
         int myChunk = t->chunksClaimed.fetch_add(1);
-        if(myChunk < totalOldChunks){
-            migrate(tid, t, myChunk);
-            t->chunksDone.fetch_add(1);
-            //cout << " totalOldChunks: " << totalOldChunks << " chunksClaimed: " << t->chunksClaimed << " chunksDone: " <<  t->chunksDone << endl;
-        }
-    }
-    while (t->chunksDone != totalOldChunks){
-        //assert(false);
-        //wait till all chunks are migrated
+        if (myChunk < t->totalOldChunks) migrateChunk(tid, t, myChunk);
     }
 
+    // once a chunk is migrated, its buckets never change, and every probe sequence ends at an (empty) bucket,
+    // or wraps around the whole table if it was full
+    int index = h % t->oldCapacity;
+    for (int i = 0; i < t->oldCapacity; ++i) {
+        migrateChunk(tid, t, index / CHUNK_SIZE);
+        if (getKey(t->oldData[index].key) == EMPTY) return;
+        index = (index + 1) % t->oldCapacity;
+    }
 }
 
-void AlgorithmD::startExpansion(const int tid, table * t) {
+// migrate every chunk of t that is not migrated yet (without waiting for other threads)
+template <class HashFunction>
+void AlgorithmD<HashFunction>::finishExpansion(const int tid, table * t) {
+    for (int chunk = 0; t->chunksDone < t->totalOldChunks && chunk < t->totalOldChunks; ++chunk) {
+        migrateChunk(tid, t, chunk);
+    }
+}
 
+// replace t with a new table whose capacity is chosen by the resize policy (using accurate counts).
+// returns false if the accurate counts show that no resize is needed after all.
+template <class HashFunction>
+bool AlgorithmD<HashFunction>::startExpansion(const int tid, table * t) {
 
     if(currentTable.load() == t){
-        //cout << " ***************** sum of keys before migration (old struct): " << getSumOfKeys() <<  " ********************** "<<endl;
-        //cout << " po_cap: " << t->oldCapacity << " pn_cap: " << t->currCapacity << " chunksClaimed: " << t->chunksClaimed << " chunksDone: " << t->chunksDone << endl;
-        int noOfKeys = t->insertAC->getAccurate() - t->deleteAC->getAccurate();
-        int newCap = 4 * noOfKeys;
-        if(newCap == 0){
-            assert(false);
-            newCap = 2 * t->currCapacity;
-        }
-        if (newCap < 0){
-            assert(newCap < 0);
-        }
-        
-        
-        table * t_new = new table(t->currCapacity, t->currData, newCap, numThreads);
+        // t can only be replaced once everything in its predecessor has been migrated into it
+        finishExpansion(tid, t);
+
+        int64_t noOfKeys = t->insertAC->getAccurate() - t->deleteAC->getAccurate();
+        int64_t usedSlots = t->slotsAC->getAccurate();
+        auto action = policy.getAction(t->currCapacity, noOfKeys, usedSlots);
+        if(action == RESIZE_NONE){
+            return false;
+        }
+        int newCap = (action == RESIZE_CLEANUP) ? t->currCapacity : policy.getNewCapacity(noOfKeys);
+        assert(newCap > 0);
+
+        table * t_new = new table(t, newCap, numThreads, storage, 0);
         if(!currentTable.compare_exchange_strong(t, t_new)){
             //delete newly created struct
-            delete t_new;            
+            t_new->prev = NULL;
+            delete t_new;
         }
         else{
-            //delete t->insertAC;
-            //delete t->deleteAC;
-            /*if(t->oldData != NULL){
-                delete[] t->oldData;
-            }*/
-        }
-        
-        table * ct = currentTable.load();
-        //cout << " no_cap: " << ct->oldCapacity << " nn_cap: " << ct->currCapacity << " chunksClaimed: " << ct->chunksClaimed << " chunksDone: " << ct->chunksDone << endl;
+            numResizes[action]++;
+        }
     }
-
-    helpExpansion(tid, currentTable.load());
+    return true;
 
 }
 
-void AlgorithmD::migrate(const int tid, table * t, int myChunk) {
+// migrate chunk myChunk of t->oldData into t->currData. any number of threads can do this concurrently.
+template <class HashFunction>
+void AlgorithmD<HashFunction>::migrateChunk(const int tid, table * t, int myChunk) {
+    if (t->chunkMigrated[myChunk]) return;
 
-    int start_index = myChunk * 4096;
-    int end_index = min(start_index + 4096, t->oldCapacity);
+    int start_index = myChunk * CHUNK_SIZE;
+    int end_index = min(start_index + CHUNK_SIZE, t->oldCapacity);
+    for(int i = start_index; i < end_index; ++i){
+        migrateBucket(tid, t, i);
+    }
+
+    bool expected = false;
+    if (t->chunkMigrated[myChunk].compare_exchange_strong(expected, true)) {
+        if(t->chunksDone.fetch_add(1) + 1 == t->totalOldChunks){
+            // we finished the migration, so nobody will read t->oldData any more (except threads that
+            // still hold a pointer to t->prev, or are still migrating a chunk, which the reclaimer protects)
+            table * prev = t->prev;
+            t->prev = NULL;
+            recmgr->retire(tid, prev);
+        }
+    }
+}
+
+template <class HashFunction>
+void AlgorithmD<HashFunction>::migrateBucket(const int tid, table * t, int index) {
     ATOMIC_BUCKET * oldData = t->oldData;
-    ATOMIC_BUCKET * currData = t->currData;
+    int found = oldData[index].key;
+    while(!isMarked(found) && !oldData[index].key.compare_exchange_weak(found, found | MARKED_MASK)){
+        // found was updated by the failed CAS
+    }
+    if(getKey(found) != EMPTY && !isDeleted(found)){
+        insertMigrated(tid, t, getKey(found));
+    }
+}
 
-    //cout << " chunkID: " << myChunk << " startIndex: " << start_index << " endIndex: " << end_index << endl;
-    for(int i = start_index; i < end_index; ++i){
-        int found = oldData[i].key;
-        while(!oldData[i].key.compare_exchange_strong(found, found | MARKED_MASK)){
-            //assert(false);
-            found = oldData[i].key;
+// insert a key being migrated into t, unless a bucket with this key (deleted or not) already exists.
+// no other operation on this key can use t until the key has been migrated, so the only concurrent
+// operations that can write this key are other migration inserts.
+template <class HashFunction>
+void AlgorithmD<HashFunction>::insertMigrated(const int tid, table * t, int key) {
+    ATOMIC_BUCKET * data = t->currData;
+    int capacity = t->currCapacity;
+    uint32_t h = HashFunction::hash(key);
+
+    for(uint32_t i = 0; i < capacity; ++i){
+        uint32_t index = (h + i) % capacity;
+        int found = data[index].key;
+        if(found == EMPTY){
+            if(data[index].key.compare_exchange_strong(found, key)){
+                t->insertAC->inc(tid);
+                t->slotsAC->inc(tid);
+                return;
+            }
         }
-        int key = getKey(oldData[i].key);
-        if(key != TOMBSTONE && key != EMPTY){
-            insertIfAbsent(tid, key, true);
+        if(getKey(found) == key){
+            return;
         }
     }
-    //cout << "-------------- During Migration: Sum oldKeys: " << getSumOld() << " Sum newKeys: " << getSumOfKeys() <<   " -------------- "<<endl;
-    //cout << endl;
+    assert(false);
+}
 
+// bulk load helper: place key with a plain store, probing buckets [home, end) (mod capacity).
+// returns 1 if key was placed, 0 if it was already there, and -1 if every bucket in the range is used.
+template <class HashFunction>
+int AlgorithmD<HashFunction>::bulkPlace(ATOMIC_BUCKET * data, int64_t capacity, int key, int64_t home, int64_t end) {
+    for (int64_t i = home; i < end; ++i) {
+        atomic<int> & bucket = data[i % capacity].key;
+        int found = bucket.load(std::memory_order_relaxed);
+        if (found == EMPTY) {
+            bucket.store(key, std::memory_order_relaxed);
+            return 1;
+        }
+        if (found == key) return 0;
+    }
+    return -1;
 }
 
 // semantics: try to insert key. return true if successful (if key doesn't already exist), and false otherwise
-bool AlgorithmD::insertIfAbsent(const int tid, const int & key, bool disableExpansion = false) {
-    
+template <class HashFunction>
+bool AlgorithmD<HashFunction>::insertIfAbsent(const int tid, const int & key) {
+    auto guard = recmgr->getGuard(tid);
+    return insertInternal(tid, key, HashFunction::hash(key));
+}
+
+template <class HashFunction>
+bool AlgorithmD<HashFunction>::insertInternal(const int tid, const int & key, uint32_t h) {
+
     table * t = currentTable.load();
     ATOMIC_BUCKET * data = t->currData;
     int capacity = t->currCapacity;
-    uint32_t h = murmur3(key);
+    helpExpansion(tid, t, h);
 
     for(uint32_t i = 0; i < capacity; ++i){
 
-        if(disableExpansion){
-            assert(key > 0);
-            assert(key != TOMBSTONE);
-        }
-
-        if (!disableExpansion && expandAsNeeded(tid, t, i)){
-            return insertIfAbsent(tid, key, disableExpansion);
+        if (expandAsNeeded(tid, t, i)){
+            return insertInternal(tid, key, h);
         }
 
         uint32_t index = (h + i) % capacity;
         int found = data[index].key;
-        //int currKey = getKey(found);
 
-        if(!disableExpansion && isMarked(found)){
-            return insertIfAbsent(tid, key, disableExpansion);
+        if(found == EMPTY){
+            if (data[index].key.compare_exchange_strong(found, key)){
+                t->insertAC->inc(tid);
+                t->slotsAC->inc(tid);
+                return true;
+            }
+            // found was updated by the failed CAS
+        }
+        if(isMarked(found)){
+            return insertInternal(tid, key, h);
         }
         else if(found == key){
-            if(disableExpansion){
-                assert(false);
-            }
             return false;
         }
-        else if(found == EMPTY){
+        else if(found == (key | DELETED_MASK)){
+            // re-insert into the bucket this key was erased from
             if (data[index].key.compare_exchange_strong(found, key)){
                 t->insertAC->inc(tid);
                 return true;
             }
-            else{
-                found = data[index].key;
-                //currKey = getKey(found);
-
-                if(!disableExpansion && isMarked(found)){
-                    return insertIfAbsent(tid, key, disableExpansion); 
-                }
-                else if (found == key){
-                    if(disableExpansion){
-                        assert(false);
-                    }
-                    return false;
-                }
+            if(isMarked(found)){
+                return insertInternal(tid, key, h);
             }
+            return false; // found == key
         }
     }
     //return false;
@@ -270,103 +532,217 @@ bool AlgorithmD::insertIfAbsent(const int tid, const int & key, bool disableExpa
 }
 
 // semantics: try to erase key. return true if successful, and false otherwise
-bool AlgorithmD::erase(const int tid, const int & key) {
+template <class HashFunction>
+bool AlgorithmD<HashFunction>::erase(const int tid, const int & key) {
+    auto guard = recmgr->getGuard(tid);
+    return eraseInternal(tid, key, HashFunction::hash(key));
+}
+
+template <class HashFunction>
+bool AlgorithmD<HashFunction>::eraseInternal(const int tid, const int & key, uint32_t h) {
 
     table * t = currentTable.load();
     ATOMIC_BUCKET * data = t->currData;
     int capacity = t->currCapacity;
-    uint32_t h = murmur3(key);
+    helpExpansion(tid, t, h);
 
     for(uint32_t i = 0; i < capacity; ++i){
         if(expandAsNeeded(tid, t, i)){
-            return erase(tid, key);
+            return eraseInternal(tid, key, h);
         }
 
         uint32_t index = (h + i) % capacity;
         int found = data[index].key;
-        //int currKey = getKey(found);
 
-        if (found == EMPTY){
-            return false;
+        if(isMarked(found)){
+            return eraseInternal(tid, key, h);
         }
-        else if(isMarked(found)){
-            return erase(tid, key);
+        else if (found == EMPTY){
+            return false;
         }
         else if(found == key){
-            if (data[index].key.compare_exchange_strong(found, TOMBSTONE)){
-                t->deleteAC->inc(tid);
+            if (data[index].key.compare_exchange_strong(found, key | DELETED_MASK)){
+                if (t->deleteAC->inc(tid)) shrinkAsNeeded(tid, t);
                 return true;
             }
-            found = data[index].key;
-            //currKey = getKey(found);
             if(isMarked(found)){
-                return erase(tid, key); 
-            }
-            else if(found == TOMBSTONE){
-                return false;
+                return eraseInternal(tid, key, h);
             }
+            return false; // found == (key | DELETED_MASK)
+        }
+        else if(found == (key | DELETED_MASK)){
+            return false;
         }
     }
     return false;
 }
 
-// semantics: return the sum of all KEYS in the set
-int64_t AlgorithmD::getSumOfKeys() {
-    int64_t sum = 0;
+// semantics: return true if key is in the set, and false otherwise
+template <class HashFunction>
+bool AlgorithmD<HashFunction>::contains(const int tid, const int & key) {
+    auto guard = recmgr->getGuard(tid);
+    return containsInternal(tid, key, HashFunction::hash(key));
+}
+
+template <class HashFunction>
+bool AlgorithmD<HashFunction>::containsInternal(const int tid, const int & key, uint32_t h) {
+
     table * t = currentTable.load();
     ATOMIC_BUCKET * data = t->currData;
     int capacity = t->currCapacity;
+    helpExpansion(tid, t, h);
 
-    for(int index = 0; index < capacity; ++index){
+    for(uint32_t i = 0; i < capacity; ++i){
+        uint32_t index = (h + i) % capacity;
         int found = data[index].key;
-        int currKey = getKey(found);
-        if (currKey != EMPTY && currKey != TOMBSTONE){
-            sum += currKey;
+
+        if(isMarked(found)){
+            return containsInternal(tid, key, h);
+        }
+        else if (found == EMPTY){
+            return false;
+        }
+        else if(getKey(found) == key){
+            return !isDeleted(found);
         }
     }
-    return sum;
+    return false;
 }
 
-int64_t AlgorithmD::getSumOld() {
-    int64_t sum = 0;
+// a batch runs under one guard, and prefetches from the table that is current when it starts
+// (if the table is replaced during the batch, the prefetches are merely useless)
+template <class HashFunction>
+void AlgorithmD<HashFunction>::insertBatch(const int tid, const int * keys, const int n, bool * results) {
+    auto guard = recmgr->getGuard(tid);
     table * t = currentTable.load();
-    ATOMIC_BUCKET * data = t->oldData;
-    int capacity = t->oldCapacity;
+    runBatch<HashFunction>(keys, n, results,
+            [&](uint32_t h) { __builtin_prefetch(&t->currData[h % t->currCapacity], 1); },
+            [&](int key, uint32_t h) { return insertInternal(tid, key, h); });
+}
 
-    for(int index = 0; index < capacity; ++index){
+template <class HashFunction>
+void AlgorithmD<HashFunction>::eraseBatch(const int tid, const int * keys, const int n, bool * results) {
+    auto guard = recmgr->getGuard(tid);
+    table * t = currentTable.load();
+    runBatch<HashFunction>(keys, n, results,
+            [&](uint32_t h) { __builtin_prefetch(&t->currData[h % t->currCapacity], 1); },
+            [&](int key, uint32_t h) { return eraseInternal(tid, key, h); });
+}
+
+template <class HashFunction>
+void AlgorithmD<HashFunction>::containsBatch(const int tid, const int * keys, const int n, bool * results) {
+    auto guard = recmgr->getGuard(tid);
+    table * t = currentTable.load();
+    runBatch<HashFunction>(keys, n, results,
+            [&](uint32_t h) { __builtin_prefetch(&t->currData[h % t->currCapacity], 0); },
+            [&](int key, uint32_t h) { return containsInternal(tid, key, h); });
+}
+
+// semantics: return the sum of all KEYS in the set
+template <class HashFunction>
+int64_t AlgorithmD<HashFunction>::getSumOfKeys() {
+    return sumKeys(0, omp_get_max_threads());
+}
+
+// call visitChunk(data, start, end) for every chunk [start, end) of the current table's buckets,
+// on numScanThreads threads, all under the caller's guard
+template <class HashFunction>
+template <class ChunkVisitor>
+void AlgorithmD<HashFunction>::forEachChunk(const int tid, const int numScanThreads, ChunkVisitor visitChunk) {
+    auto guard = recmgr->getGuard(tid);
+    table * t = currentTable.load();
+    finishExpansion(tid, t); // (by this thread alone, since migration uses tid's counters and limbo bags)
+
+    ATOMIC_BUCKET * data = t->currData;
+    const int capacity = t->currCapacity;
+    const int numChunks = (capacity + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    #pragma omp parallel for num_threads(numScanThreads) schedule(dynamic, 1)
+    for (int chunk = 0; chunk < numChunks; ++chunk) {
+        visitChunk(data, chunk * CHUNK_SIZE, min((chunk + 1) * CHUNK_SIZE, capacity));
+    }
+}
+
+template <class HashFunction>
+template <class Visitor>
+void AlgorithmD<HashFunction>::forEachKey(const int tid, Visitor visit, const int numScanThreads) {
+    forEachChunk(tid, numScanThreads, [&](ATOMIC_BUCKET * data, int start, int end) {
+        for (int index = start; index < end; ++index) {
+            int found = data[index].key;
+            if (getKey(found) != EMPTY && !isDeleted(found)) visit(getKey(found));
+        }
+    });
+}
+
+template <class HashFunction>
+int64_t AlgorithmD<HashFunction>::sumKeys(const int tid, const int numScanThreads) {
+    int64_t sum = 0;
+    forEachChunk(tid, numScanThreads, [&](ATOMIC_BUCKET * data, int start, int end) {
+        int64_t chunkSum = 0;
+        for (int index = start; index < end; ++index) {
+            int found = data[index].key;
+            if (getKey(found) != EMPTY && !isDeleted(found)) chunkSum += getKey(found);
+        }
+        __sync_fetch_and_add(&sum, chunkSum);
+    });
+    return sum;
+}
+
+template <class HashFunction>
+int64_t AlgorithmD<HashFunction>::countKeys(const int tid, const int numScanThreads) {
+    int64_t count = 0;
+    forEachChunk(tid, numScanThreads, [&](ATOMIC_BUCKET * data, int start, int end) {
+        int64_t chunkCount = 0;
+        for (int index = start; index < end; ++index) {
+            int found = data[index].key;
+            if (getKey(found) != EMPTY && !isDeleted(found)) ++chunkCount;
+        }
+        __sync_fetch_and_add(&count, chunkCount);
+    });
+    return count;
+}
+
+template <class HashFunction>
+void AlgorithmD<HashFunction>::addProbeLengths(vector<int64_t> & histogram) {
+    table * t = currentTable.load();
+    ATOMIC_BUCKET * data = t->currData;
+    int64_t capacity = t->currCapacity;
+    for(int64_t index = 0; index < capacity; ++index){
         int found = data[index].key;
-        int currKey = getKey(found);
-        if (currKey != EMPTY && currKey != TOMBSTONE){
-            sum += currKey;
+        if (getKey(found) != EMPTY && !isDeleted(found)){
+            size_t probeLength = 1 + (index - HashFunction::hash(getKey(found)) % capacity + capacity) % capacity;
+            if (histogram.size() <= probeLength) histogram.resize(probeLength + 1);
+            ++histogram[probeLength];
         }
     }
-    return sum;
 }
 
 // print any debugging details you want at the end of a trial in this function
-void AlgorithmD::printDebuggingDetails() {
-    /*
+// (not thread safe: it reads the current table while no operations are running)
+template <class HashFunction>
+void AlgorithmD<HashFunction>::printDebuggingDetails() {
     table * t = currentTable.load();
     ATOMIC_BUCKET * data = t->currData;
     int capacity = t->currCapacity;
-    cout << "Final Hash Table Capacity: " << capacity <<endl;
-    if(capacity > 50){
-        capacity = 50; 
-    }
 
+    // probe length of a key = number of buckets read to find it
+    int64_t live = 0, deleted = 0, totalProbeLength = 0, maxProbeLength = 0;
     for(int index = 0; index < capacity; ++index){
         int found = data[index].key;
         int currKey = getKey(found);
         if (currKey == EMPTY){
-            cout << " E ";
+            continue;
         }
-        else if(currKey == TOMBSTONE){
-            cout << " T ";
+        else if(isDeleted(found)){
+            ++deleted;
         }
         else{
-            cout << currKey;
+            ++live;
+            int64_t probeLength = 1 + ((index - (int64_t) (HashFunction::hash(currKey) % capacity)) + capacity) % capacity;
+            totalProbeLength += probeLength;
+            maxProbeLength = max(maxProbeLength, probeLength);
         }
     }
-    cout <<endl;*/
-
+    cout<<"capacity="<<capacity<<" live="<<live<<" deleted="<<deleted;
+    cout<<" avgProbeLength="<<(live ? (double) totalProbeLength / live : 0)<<" maxProbeLength="<<maxProbeLength;
+    cout<<" grows="<<numResizes[RESIZE_GROW]<<" shrinks="<<numResizes[RESIZE_SHRINK]<<" cleanups="<<numResizes[RESIZE_CLEANUP]<<endl;
 }
@@ -0,0 +1,492 @@
+#pragma once
+#include "util.h"
+#include "recordmgr/record_manager.h"   // from assignment-5 (see Makefile)
+#include "resize_policy.h"              // from assignment-7/common
+#include <atomic>
+#include <cassert>
+#include <cstring>
+#include <optional>
+#include <type_traits>
+using namespace std;
+
+#ifndef __GCC_HAVE_SYNC_COMPARE_AND_SWAP_16
+#error "AlgorithmDMap needs a 16 byte CAS (compile with -mcx16)"
+#endif
+
+// a key and its value, updated together by a 16 byte CAS
+struct alignas(16) MAP_BUCKET {
+    volatile uint64_t key;          // key, plus MARKED and DELETED bits (see AlgorithmDMap)
+    volatile uint64_t value;
+};
+
+/**
+ * Concurrent map from 64-bit keys to 64-bit values, based on AlgorithmD (see alg_d.h).
+ *
+ * Each bucket is a (key word, value) pair, and every change to a bucket is a 16 byte CAS on the whole pair,
+ * so a value can never be associated with the wrong key, and a bucket is frozen (marked) together with its value
+ * when it is migrated. As in AlgorithmD, a bucket holds the same key forever once a key is written, and remove
+ * sets the DELETED bit of the key word (keeping the old value) instead of writing a tombstone, so migration
+ * inserts are idempotent, and expansion is non-blocking and incremental (in chunks of CHUNK_SIZE buckets).
+ *
+ * get does not CAS: it reads the key word, then the value, then the key word again. if the key was present at
+ * the first read and the bucket was not marked at the second, then the value it read was the key's value either
+ * when it was read, or just before the key was removed (since remove keeps the value), both while get was running.
+ *
+ * K and V can be any trivially copyable types of at most 8 bytes. keys are compared as 64-bit words, and
+ * the two most significant bits are reserved, so keys must be in [1, 2^62) (which is asserted).
+ */
+template <typename K = int64_t, typename V = int64_t>
+class AlgorithmDMap {
+    static_assert(sizeof(K) <= 8 && is_trivially_copyable<K>::value, "keys must be trivially copyable and at most 8 bytes");
+    static_assert(sizeof(V) <= 8 && is_trivially_copyable<V>::value, "values must be trivially copyable and at most 8 bytes");
+
+private:
+    static constexpr uint64_t MARKED_MASK = 1ULL<<63;   // bucket is frozen for migration
+    static constexpr uint64_t DELETED_MASK = 1ULL<<62;  // key was removed (the bucket still holds its last value)
+    static constexpr uint64_t EMPTY = 0;
+    static const int CHUNK_SIZE = 4096;                 // number of buckets migrated at a time
+
+    // what an update does to a key, given whether it is present and its current value
+    enum update_kind_t { UPDATE_NONE, UPDATE_STORE, UPDATE_REMOVE };
+    struct update_t {
+        update_kind_t kind;
+        uint64_t value;
+    };
+
+    // same life cycle as AlgorithmD::table
+    struct table {
+        char padding0[PADDING_BYTES];
+        table * prev;                       // table we migrate from (NULL once it has been retired)
+        MAP_BUCKET * oldData;
+        MAP_BUCKET * currData;
+        int64_t currCapacity;
+        int64_t oldCapacity;
+        int totalOldChunks;
+        atomic<bool> * chunkMigrated;       // per chunk of oldData: has every bucket in it been migrated?
+        counter * insertAC;                 // keys that became present (live keys = inserts - deletes)
+        counter * deleteAC;
+        counter * slotsAC;                  // buckets that went from EMPTY to holding a key (used buckets)
+        char padding1[PADDING_BYTES];
+        atomic<int> chunksClaimed;
+        char padding2[PADDING_BYTES];
+        atomic<int> chunksDone;
+        char padding3[PADDING_BYTES];
+
+        table(table * _prev, int64_t currC, int nThreads){
+            prev = _prev;
+            oldData = prev ? prev->currData : NULL;
+            oldCapacity = prev ? prev->currCapacity : 0;
+            totalOldChunks = (oldCapacity + CHUNK_SIZE - 1) / CHUNK_SIZE;
+
+            currCapacity = currC;
+            currData = new MAP_BUCKET[currCapacity];
+            for(int64_t i = 0; i < currCapacity; ++i){
+                currData[i].key = EMPTY;
+                currData[i].value = 0;
+            }
+
+            chunkMigrated = new atomic<bool>[totalOldChunks];
+            for(int i = 0; i < totalOldChunks; ++i){
+                chunkMigrated[i].store(false, std::memory_order_relaxed);
+            }
+            insertAC = new counter(nThreads);
+            deleteAC = new counter(nThreads);
+            slotsAC = new counter(nThreads);
+            chunksClaimed = 0;
+            chunksDone = 0;
+        }
+
+        ~table(){
+            delete insertAC;
+            delete deleteAC;
+            delete slotsAC;
+            delete[] chunkMigrated;
+            delete[] currData;
+        }
+    };
+
+    char padding0[PADDING_BYTES];
+    int numThreads;
+    resize_policy_t policy;
+    atomic<table *> currentTable;
+    char padding1[PADDING_BYTES];
+    simple_record_manager<table> * recmgr; // epoch based reclamation (DEBRA) of replaced tables
+    char padding2[PADDING_BYTES];
+    atomic<int64_t> numResizes[RESIZE_CLEANUP+1];
+    char padding3[PADDING_BYTES];
+
+    template <typename T>
+    static uint64_t toWord(const T & x) {
+        uint64_t w = 0;
+        memcpy(&w, &x, sizeof(T));
+        return w;
+    }
+    template <typename T>
+    static T fromWord(uint64_t w) {
+        T x;
+        memcpy(&x, &w, sizeof(T));
+        return x;
+    }
+
+    static uint64_t getKey(uint64_t kw) { return kw & ~(MARKED_MASK | DELETED_MASK); }
+    static bool isMarked(uint64_t kw) { return (kw & MARKED_MASK) != 0; }
+    static bool isDeleted(uint64_t kw) { return (kw & DELETED_MASK) != 0; }
+    static bool isValidKey(uint64_t key) { return key != EMPTY && getKey(key) == key; } // in [1, 2^62)
+
+    // murmur3 64-bit finalizer
+    static uint64_t hash(uint64_t k) {
+        k ^= k >> 33;
+        k *= 0xFF51AFD7ED558CCDULL;
+        k ^= k >> 33;
+        k *= 0xC4CEB9FE1A85EC53ULL;
+        k ^= k >> 33;
+        return k;
+    }
+
+    // CAS the bucket from (expKey, expValue) to (newKey, newValue).
+    // on failure, expKey and expValue are set to the bucket's current contents (read atomically).
+    static bool cas(MAP_BUCKET * b, uint64_t & expKey, uint64_t & expValue, uint64_t newKey, uint64_t newValue) {
+        unsigned __int128 expected = ((unsigned __int128) expValue << 64) | expKey;
+        unsigned __int128 desired = ((unsigned __int128) newValue << 64) | newKey;
+        unsigned __int128 actual = __sync_val_compare_and_swap((unsigned __int128 *) b, expected, desired);
+        if (actual == expected) return true;
+        expKey = (uint64_t) actual;
+        expValue = (uint64_t) (actual >> 64);
+        return false;
+    }
+
+    // called on every probe of an update: rebuild t if too many of its buckets are used
+    bool expandAsNeeded(const int tid, table * t, int64_t i) {
+        const double maxUsed = policy.maxLoadFactor * t->currCapacity;
+        if((t->slotsAC->get() > maxUsed) || (i > 50 && t->slotsAC->getAccurate() > maxUsed)){
+            return startExpansion(tid, t);
+        }
+        return false;
+    }
+
+    // called after a remove flushes its deleteAC subcounter: shrink t if too few keys are live
+    bool shrinkAsNeeded(const int tid, table * t) {
+        const int64_t live = t->insertAC->get() - t->deleteAC->get();
+        if (live < policy.minLoadFactor * t->currCapacity && t->currCapacity > policy.minCapacity) {
+            return startExpansion(tid, t);
+        }
+        return false;
+    }
+
+    // migrate one unclaimed chunk, then every chunk that the key's probe sequence in the old table passes through
+    void helpExpansion(const int tid, table * t, uint64_t h) {
+        if (t->chunksDone == t->totalOldChunks) return;
+
+        if (t->chunksClaimed < t->totalOldChunks) {
+            int myChunk = t->chunksClaimed.fetch_add(1);
+            if (myChunk < t->totalOldChunks) migrateChunk(tid, t, myChunk);
+        }
+
+        int64_t index = h % t->oldCapacity;
+        for (int64_t i = 0; i < t->oldCapacity; ++i) { // (wraps around the whole table if it was full)
+            migrateChunk(tid, t, index / CHUNK_SIZE);
+            if (getKey(t->oldData[index].key) == EMPTY) return;
+            index = (index + 1) % t->oldCapacity;
+        }
+    }
+
+    void finishExpansion(const int tid, table * t) {
+        for (int chunk = 0; t->chunksDone < t->totalOldChunks && chunk < t->totalOldChunks; ++chunk) {
+            migrateChunk(tid, t, chunk);
+        }
+    }
+
+    // replace t with a new table whose capacity is chosen by the resize policy (using accurate counts).
+    // returns false if no resize is needed after all.
+    bool startExpansion(const int tid, table * t) {
+        if(currentTable.load() == t){
+            finishExpansion(tid, t);
+
+            int64_t noOfKeys = t->insertAC->getAccurate() - t->deleteAC->getAccurate();
+            auto action = policy.getAction(t->currCapacity, noOfKeys, t->slotsAC->getAccurate());
+            if(action == RESIZE_NONE){
+                return false;
+            }
+            int64_t newCap = (action == RESIZE_CLEANUP) ? t->currCapacity : policy.getNewCapacity(noOfKeys);
+
+            table * t_new = new table(t, newCap, numThreads);
+            if(!currentTable.compare_exchange_strong(t, t_new)){
+                t_new->prev = NULL;
+                delete t_new;
+            }
+            else{
+                numResizes[action]++;
+            }
+        }
+        return true;
+    }
+
+    void migrateChunk(const int tid, table * t, int myChunk) {
+        if (t->chunkMigrated[myChunk]) return;
+
+        int64_t start_index = (int64_t) myChunk * CHUNK_SIZE;
+        int64_t end_index = min(start_index + CHUNK_SIZE, t->oldCapacity);
+        for(int64_t i = start_index; i < end_index; ++i){
+            migrateBucket(tid, t, i);
+        }
+
+        bool expected = false;
+        if (t->chunkMigrated[myChunk].compare_exchange_strong(expected, true)) {
+            if(t->chunksDone.fetch_add(1) + 1 == t->totalOldChunks){
+                table * prev = t->prev;
+                t->prev = NULL;
+                recmgr->retire(tid, prev);
+            }
+        }
+    }
+
+    // freeze the bucket (with its value), then copy it into t if its key is present
+    void migrateBucket(const int tid, table * t, int64_t index) {
+        MAP_BUCKET * b = &t->oldData[index];
+        uint64_t kw = b->key;
+        uint64_t v = b->value;
+        while(!isMarked(kw) && !cas(b, kw, v, kw | MARKED_MASK, v)){
+            // kw and v were updated by the failed CAS
+        }
+        if(getKey(kw) != EMPTY && !isDeleted(kw)){
+            insertMigrated(tid, t, getKey(kw), v);
+        }
+    }
+
+    // insert a migrated pair into t, unless a bucket with this key (removed or not) already exists.
+    // (only other migration inserts can write this key in t until it has been migrated, as in AlgorithmD.)
+    void insertMigrated(const int tid, table * t, uint64_t key, uint64_t value) {
+        MAP_BUCKET * data = t->currData;
+        int64_t capacity = t->currCapacity;
+        uint64_t h = hash(key);
+
+        for(int64_t i = 0; i < capacity; ){
+            int64_t index = (h + i) % capacity;
+            uint64_t kw = data[index].key;
+            uint64_t v = 0;
+            if(kw == EMPTY){
+                if(cas(&data[index], kw, v, key, value)){
+                    t->insertAC->inc(tid);
+                    t->slotsAC->inc(tid);
+                    return;
+                }
+                continue; // re-examine this bucket
+            }
+            if(getKey(kw) == key){
+                return;
+            }
+            ++i;
+        }
+        assert(false);
+    }
+
+    // find the bucket for key and apply decide(present, currentValue) to it atomically.
+    // decide may be called several times (if CASes fail), and the update it returns last is the one that took effect.
+    // returns whether the key was present, and sets oldValue to its value if so.
+    template <class Decide>
+    bool updateInternal(const int tid, uint64_t key, Decide decide, uint64_t & oldValue) {
+        assert(isValidKey(key));
+        table * t = currentTable.load();
+        MAP_BUCKET * data = t->currData;
+        int64_t capacity = t->currCapacity;
+        uint64_t h = hash(key);
+        helpExpansion(tid, t, h);
+
+        for(int64_t i = 0; i < capacity; ++i){
+            if(expandAsNeeded(tid, t, i)){
+                return updateInternal(tid, key, decide, oldValue);
+            }
+
+            int64_t index = (h + i) % capacity;
+            MAP_BUCKET * b = &data[index];
+            uint64_t kw = b->key;
+            uint64_t v = b->value;
+
+            while (true) { // until this bucket is found not to hold key, or a CAS on it succeeds
+                if(isMarked(kw)){
+                    return updateInternal(tid, key, decide, oldValue);
+                }
+                const bool isEmpty = (kw == EMPTY);
+                if(!isEmpty && getKey(kw) != key){
+                    break; // next bucket
+                }
+
+                const bool present = !isEmpty && !isDeleted(kw);
+                update_t u = decide(present, v);
+                if(u.kind == UPDATE_NONE || (u.kind == UPDATE_REMOVE && !present)){
+                    if(present && isMarked(b->key)){ // v may have been read after the bucket was frozen (see get)
+                        return updateInternal(tid, key, decide, oldValue);
+                    }
+                    oldValue = v;
+                    return present;
+                }
+
+                uint64_t newKey = (u.kind == UPDATE_STORE) ? key : (key | DELETED_MASK);
+                uint64_t newValue = (u.kind == UPDATE_STORE) ? u.value : v;   // remove keeps the last value
+                uint64_t expValue = isEmpty ? 0 : v;
+                if(cas(b, kw, expValue, newKey, newValue)){
+                    if(isEmpty){
+                        t->slotsAC->inc(tid);
+                    }
+                    if(!present){
+                        t->insertAC->inc(tid);
+                    }
+                    else if(u.kind == UPDATE_REMOVE){
+                        if (t->deleteAC->inc(tid)) shrinkAsNeeded(tid, t);
+                    }
+                    oldValue = v;
+                    return present;
+                }
+                v = expValue; // kw and expValue were updated by the failed CAS
+            }
+        }
+        assert(false);
+        return false;
+    }
+
+    bool getInternal(const int tid, uint64_t key, uint64_t & value) {
+        assert(isValidKey(key));
+        table * t = currentTable.load();
+        MAP_BUCKET * data = t->currData;
+        int64_t capacity = t->currCapacity;
+        uint64_t h = hash(key);
+        helpExpansion(tid, t, h);
+
+        for(int64_t i = 0; i < capacity; ++i){
+            MAP_BUCKET * b = &data[(h + i) % capacity];
+            uint64_t kw = b->key;
+            if(isMarked(kw)){
+                return getInternal(tid, key, value);
+            }
+            if(kw == EMPTY){
+                return false;
+            }
+            if(getKey(kw) == key){
+                if(isDeleted(kw)){
+                    return false;
+                }
+                uint64_t v = b->value;
+                if(isMarked(b->key)){
+                    return getInternal(tid, key, value);
+                }
+                value = v;
+                return true;
+            }
+        }
+        return false;
+    }
+
+public:
+    /**
+     * @param _numThreads maximum number of threads that will ever use the map
+     * @param _capacity is the INITIAL size of the table (maximum number of keys it can contain WITHOUT expansion)
+     * @param _policy determines when the table is grown, shrunk or cleaned up (its minCapacity defaults to _capacity)
+     */
+    AlgorithmDMap(const int _numThreads, const int64_t _capacity, const resize_policy_t & _policy = resize_policy_t())
+    : numThreads(_numThreads), policy(_policy) {
+        if (policy.minCapacity == 0) policy.minCapacity = _capacity;
+        for (auto & n : numResizes) n = 0;
+        recmgr = new simple_record_manager<table>(MAX_THREADS);
+        currentTable = new table(NULL, _capacity, _numThreads);
+    }
+
+    ~AlgorithmDMap() {
+        table * t = currentTable.load();
+        if (t->prev) delete t->prev; // migration into t was never finished
+        delete t;
+        delete recmgr;
+    }
+
+    // if key is present, set value to its value and return true. otherwise, return false.
+    bool get(const int tid, const K & key, V & value) {
+        auto guard = recmgr->getGuard(tid);
+        uint64_t v;
+        if (!getInternal(tid, toWord(key), v)) return false;
+        value = fromWord<V>(v);
+        return true;
+    }
+
+    // associate key with value. returns true if key was absent. otherwise, sets *oldValue (if not NULL) to the value it replaced.
+    bool put(const int tid, const K & key, const V & value, V * oldValue = NULL) {
+        auto guard = recmgr->getGuard(tid);
+        uint64_t w = toWord(value), old;
+        bool present = updateInternal(tid, toWord(key), [&](bool, uint64_t) { return update_t { UPDATE_STORE, w }; }, old);
+        if (present && oldValue) *oldValue = fromWord<V>(old);
+        return !present;
+    }
+
+    // associate key with value if key is absent, and return true. otherwise, set *existing (if not NULL) to its value, and return false.
+    bool putIfAbsent(const int tid, const K & key, const V & value, V * existing = NULL) {
+        auto guard = recmgr->getGuard(tid);
+        uint64_t w = toWord(value), old;
+        bool present = updateInternal(tid, toWord(key), [&](bool present, uint64_t) {
+            return update_t { present ? UPDATE_NONE : UPDATE_STORE, w };
+        }, old);
+        if (present && existing) *existing = fromWord<V>(old);
+        return !present;
+    }
+
+    // remove key if it is present, and return true (setting *oldValue, if not NULL, to its value). otherwise, return false.
+    bool remove(const int tid, const K & key, V * oldValue = NULL) {
+        auto guard = recmgr->getGuard(tid);
+        uint64_t old;
+        bool present = updateInternal(tid, toWord(key), [&](bool, uint64_t) { return update_t { UPDATE_REMOVE, 0 }; }, old);
+        if (present && oldValue) *oldValue = fromWord<V>(old);
+        return present;
+    }
+
+    // atomically replace the value of key (or nullopt if it is absent) with f(value), where nullopt means remove key.
+    // f may be called several times (if other threads update key concurrently), so it should have no side effects.
+    // returns the new value (or nullopt).
+    template <class F>
+    optional<V> compute(const int tid, const K & key, F f) {
+        auto guard = recmgr->getGuard(tid);
+        optional<V> result;
+        uint64_t old;
+        updateInternal(tid, toWord(key), [&](bool present, uint64_t v) {
+            result = f(present ? optional<V>(fromWord<V>(v)) : optional<V>());
+            if (!result) return update_t { UPDATE_REMOVE, 0 };
+            return update_t { UPDATE_STORE, toWord(*result) };
+        }, old);
+        return result;
+    }
+
+    // set interface (key -> key), so the map can be run by benchmark.cpp
+    bool insertIfAbsent(const int tid, const int & key) {
+        return putIfAbsent(tid, (K) key, (V) key);
+    }
+    bool erase(const int tid, const int & key) {
+        return remove(tid, (K) key);
+    }
+
+    // semantics: return the sum of all keys in the map
+    // (not thread safe: it finishes any migration in progress, then sums the current table)
+    int64_t getSumOfKeys() {
+        int64_t sum = 0;
+        table * t = currentTable.load();
+        {
+            auto guard = recmgr->getGuard(0);
+            finishExpansion(0, t);
+        }
+        for(int64_t index = 0; index < t->currCapacity; ++index){
+            uint64_t kw = t->currData[index].key;
+            if (kw != EMPTY && !isDeleted(kw)){
+                sum += (int64_t) getKey(kw);
+            }
+        }
+        return sum;
+    }
+
+    // (not thread safe)
+    void printDebuggingDetails() {
+        table * t = currentTable.load();
+        int64_t live = 0, deleted = 0;
+        for(int64_t index = 0; index < t->currCapacity; ++index){
+            uint64_t kw = t->currData[index].key;
+            if (kw == EMPTY) continue;
+            if (isDeleted(kw)) ++deleted; else ++live;
+        }
+        cout<<"capacity="<<t->currCapacity<<" live="<<live<<" deleted="<<deleted;
+        cout<<" grows="<<numResizes[RESIZE_GROW]<<" shrinks="<<numResizes[RESIZE_SHRINK]<<" cleanups="<<numResizes[RESIZE_CLEANUP]<<endl;
+    }
+};
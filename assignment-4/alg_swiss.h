@@ -0,0 +1,242 @@
+#pragma once
+#include "util.h"
+#include <atomic>
+#include <cassert>
+#include <cstdlib>
+#include <emmintrin.h>
+using namespace std;
+
+/**
+ * lock-free open addressing set with SIMD group probing (in the style of Swiss tables).
+ *
+ * buckets are split into groups of 16. next to the key array is a control byte array with one byte per bucket:
+ * CTRL_EMPTY, CTRL_DELETED, or the low 7 bits of the key's hash (its tag). a probe loads the 16 control bytes of
+ * a group and compares them against the tag in one SSE2 instruction, so it only reads the keys whose tag matches
+ * (plus any bucket whose control byte is still CTRL_EMPTY). groups are visited in triangular order, and the
+ * capacity is a power of two, so no division is needed.
+ *
+ * keys are inserted and erased exactly as in AlgorithmC (CAS EMPTY -> key, and key -> TOMBSTONE), so the key
+ * array alone determines the contents of the set. a control byte is only written AFTER the CAS on its key, and
+ * acts as a filter: a bucket is skipped only if its control byte is a different tag (so its key is a different,
+ * permanently placed key, or a tombstone) or CTRL_DELETED (so its key is a tombstone). a control byte that lags
+ * behind its key (still CTRL_EMPTY) just makes a probe read that key.
+ */
+class AlgorithmSwiss {
+public:
+    static constexpr int TOMBSTONE = -1;
+    static constexpr int EMPTY = 0;
+    static constexpr int GROUP_SIZE = 16;
+    static constexpr uint8_t CTRL_EMPTY = 0x80;
+    static constexpr uint8_t CTRL_DELETED = 0xFE;
+
+    char padding0[PADDING_BYTES];
+    const int numThreads;
+    int capacity;                   // power of two, at least GROUP_SIZE
+    uint32_t numGroups;
+    uint32_t groupMask;
+    uint8_t * ctrl;
+    atomic<int> * keys;
+    char padding2[PADDING_BYTES];
+
+    AlgorithmSwiss(const int _numThreads, const int _capacity);
+    ~AlgorithmSwiss();
+    bool insertIfAbsent(const int tid, const int & key);
+    bool erase(const int tid, const int & key);
+    bool contains(const int tid, const int & key);
+    // batched versions: results[i] is the result of the operation on batchKeys[i] (see runBatch in util.h)
+    void insertBatch(const int tid, const int * batchKeys, const int n, bool * results);
+    void eraseBatch(const int tid, const int * batchKeys, const int n, bool * results);
+    void containsBatch(const int tid, const int * batchKeys, const int n, bool * results);
+    long getSumOfKeys();
+    void printDebuggingDetails();
+
+private:
+    bool insertHashed(const int tid, const int & key, uint32_t h);
+    bool eraseHashed(const int tid, const int & key, uint32_t h);
+    bool containsHashed(const int tid, const int & key, uint32_t h);
+
+    // prefetch the control bytes and keys of the first group probed for hash h
+    inline void prefetchHome(uint32_t h, int rw) {
+        uint32_t base = ((h >> 7) & groupMask) * GROUP_SIZE;
+        __builtin_prefetch(ctrl + base, 0);
+        if (rw) __builtin_prefetch(&keys[base], 1); else __builtin_prefetch(&keys[base], 0);
+    }
+
+    // bit i of the result is set if control byte i of the group starting at bucket base equals tag or CTRL_EMPTY.
+    // both masks MUST come from a single load of the group: with two loads, a control byte could change from
+    // CTRL_EMPTY to tag in between, match neither, and the probe would skip a bucket that holds the key.
+    // (the load is a plain SSE load of bytes written with setCtrl; an aligned 16 byte load reads each byte
+    // atomically on x86, and the acquire fence orders it before the reads of the candidate keys.)
+    inline uint32_t matchGroup(uint32_t base, uint8_t tag) {
+        __m128i group = _mm_load_si128((const __m128i *) (ctrl + base));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        uint32_t matchTag = _mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8((char) tag)));
+        uint32_t matchEmpty = _mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8((char) CTRL_EMPTY)));
+        return matchTag | matchEmpty;
+    }
+    inline void setCtrl(uint32_t index, uint8_t c) {
+        __atomic_store_n(&ctrl[index], c, __ATOMIC_RELEASE);
+    }
+};
+
+/**
+ * constructor: initialize the hash table's internals
+ *
+ * @param _numThreads maximum number of threads that will ever use the hash table (i.e., at least tid+1, where tid is the largest thread ID passed to any function of this class)
+ * @param _capacity is the INITIAL size of the hash table (rounded up to a power of two, and at least GROUP_SIZE)
+ */
+AlgorithmSwiss::AlgorithmSwiss(const int _numThreads, const int _capacity)
+: numThreads(_numThreads) {
+
+    capacity = GROUP_SIZE;
+    while (capacity < _capacity) capacity *= 2;
+    numGroups = capacity / GROUP_SIZE;
+    groupMask = numGroups - 1;
+
+    ctrl = (uint8_t *) aligned_alloc(64, capacity);
+    keys = (atomic<int> *) aligned_alloc(64, capacity * sizeof(atomic<int>));
+    for(int i = 0; i < capacity; ++i){
+        ctrl[i] = CTRL_EMPTY;
+        new (&keys[i]) atomic<int>(EMPTY);
+    }
+
+}
+
+// destructor: clean up any allocated memory, etc.
+AlgorithmSwiss::~AlgorithmSwiss() {
+    free(ctrl);
+    free(keys);
+}
+
+// semantics: try to insert key. return true if successful (if key doesn't already exist), and false otherwise
+bool AlgorithmSwiss::insertIfAbsent(const int tid, const int & key) {
+    return insertHashed(tid, key, murmur3(key));
+}
+
+bool AlgorithmSwiss::insertHashed(const int tid, const int & key, uint32_t h) {
+    uint8_t tag = h & 0x7F;
+    uint32_t g = (h >> 7) & groupMask;
+    for(uint32_t probe = 0; probe < numGroups; ++probe){
+
+        uint32_t base = g * GROUP_SIZE;
+        uint32_t candidates = matchGroup(base, tag);
+        while (candidates){
+            uint32_t index = base + __builtin_ctz(candidates);
+            candidates &= candidates - 1;
+
+            int found = keys[index];
+            if (found == key){
+                return false; //LP is last read of keys[index]
+            }
+            else if (found == EMPTY){
+                if (keys[index].compare_exchange_strong(found, key)){
+                    setCtrl(index, tag);
+                    return true; //LP is the CAS
+                }
+                else if (found == key){
+                    return false;
+                }
+            }
+        }
+        g = (g + probe + 1) & groupMask; // triangular probing visits every group
+    }
+    return false;
+}
+
+// semantics: try to erase key. return true if successful, and false otherwise
+bool AlgorithmSwiss::erase(const int tid, const int & key) {
+    return eraseHashed(tid, key, murmur3(key));
+}
+
+bool AlgorithmSwiss::eraseHashed(const int tid, const int & key, uint32_t h) {
+    uint8_t tag = h & 0x7F;
+    uint32_t g = (h >> 7) & groupMask;
+    for(uint32_t probe = 0; probe < numGroups; ++probe){
+
+        uint32_t base = g * GROUP_SIZE;
+        uint32_t candidates = matchGroup(base, tag);
+        while (candidates){
+            uint32_t index = base + __builtin_ctz(candidates);
+            candidates &= candidates - 1;
+
+            int found = keys[index];
+            if (found == EMPTY){
+                return false;
+            }
+            else if (found == key){
+                if (keys[index].compare_exchange_strong(found, TOMBSTONE)){
+                    setCtrl(index, CTRL_DELETED);
+                    return true;
+                }
+                return false;
+            }
+        }
+        g = (g + probe + 1) & groupMask;
+    }
+    return false;
+}
+
+// semantics: return true if key is in the set, and false otherwise
+bool AlgorithmSwiss::contains(const int tid, const int & key) {
+    return containsHashed(tid, key, murmur3(key));
+}
+
+bool AlgorithmSwiss::containsHashed(const int tid, const int & key, uint32_t h) {
+
+    uint8_t tag = h & 0x7F;
+    uint32_t g = (h >> 7) & groupMask;
+    for(uint32_t probe = 0; probe < numGroups; ++probe){
+
+        uint32_t base = g * GROUP_SIZE;
+        uint32_t candidates = matchGroup(base, tag);
+        while (candidates){
+            uint32_t index = base + __builtin_ctz(candidates);
+            candidates &= candidates - 1;
+
+            int found = keys[index];
+            if (found == EMPTY){
+                return false;
+            }
+            else if (found == key){
+                return true;
+            }
+        }
+        g = (g + probe + 1) & groupMask;
+    }
+    return false;
+}
+
+void AlgorithmSwiss::insertBatch(const int tid, const int * batchKeys, const int n, bool * results) {
+    runBatch(batchKeys, n, results,
+            [&](uint32_t h) { prefetchHome(h, 1); },
+            [&](int key, uint32_t h) { return insertHashed(tid, key, h); });
+}
+
+void AlgorithmSwiss::eraseBatch(const int tid, const int * batchKeys, const int n, bool * results) {
+    runBatch(batchKeys, n, results,
+            [&](uint32_t h) { prefetchHome(h, 1); },
+            [&](int key, uint32_t h) { return eraseHashed(tid, key, h); });
+}
+
+void AlgorithmSwiss::containsBatch(const int tid, const int * batchKeys, const int n, bool * results) {
+    runBatch(batchKeys, n, results,
+            [&](uint32_t h) { prefetchHome(h, 0); },
+            [&](int key, uint32_t h) { return containsHashed(tid, key, h); });
+}
+
+// semantics: return the sum of all KEYS in the set
+int64_t AlgorithmSwiss::getSumOfKeys() {
+    int64_t sum = 0;
+    for(int index = 0; index < capacity; ++index){
+        int found = keys[index];
+        if (found > 0){
+            sum += found;
+        }
+    }
+    return sum;
+}
+
+// print any debugging details you want at the end of a trial in this function
+void AlgorithmSwiss::printDebuggingDetails() {
+    cout<<"capacity="<<capacity<<" groups="<<numGroups<<endl;
+}
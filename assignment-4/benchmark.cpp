@@ -1,5 +1,6 @@
 /**
  * A simple insert & delete benchmark for (unordered) sets (e.g., hash tables).
+ * (The trial loop and output are implemented in ../assignment-7/common/set_benchmark.h)
  */
 
 #include <thread>
@@ -9,231 +10,245 @@
 #include <cstring>
 #include <iostream>
 #include <time.h>
+#include <vector>
+#include <algorithm>
 
 #include "util.h"
+#include "set_benchmark.h"
 #include "alg_a.h"
 #include "alg_b.h"
+#include "alg_a_striped.h"
+#include "alg_b_striped.h"
 #include "alg_c.h"
 #include "alg_d.h"
+#include "alg_swiss.h"
+#include "alg_d_map.h"
 
 using namespace std;
 
+// the resize policy is only passed to tables that take one (i.e., that can shrink),
+// and the storage options to tables that take them
 template <class DataStructureType>
-struct globals_t {
-    PaddedRandom rngs[MAX_THREADS];
-    volatile char padding0[PADDING_BYTES];
-    ElapsedTimer timer;
-    volatile char padding1[PADDING_BYTES];
-    long elapsedMillis;
-    volatile char padding2[PADDING_BYTES];
-    volatile bool done;
-    volatile char padding3[PADDING_BYTES];
-    volatile bool start;        // used for a custom barrier implementation (should threads start yet?)
-    volatile char padding4[PADDING_BYTES];
-    atomic_int running;         // used for a custom barrier implementation (how many threads are waiting?)
-    volatile char padding5[PADDING_BYTES];
-    DataStructureType * ds;
-    debugCounter numTotalOps;   // already has padding built in at the beginning and end
-    debugCounter keyChecksum;
-    int millisToRun;
-    int totalThreads;
-    int keyRangeSize;
-    int tableSize;
-    volatile char padding7[PADDING_BYTES];
-    
-    globals_t(int _millisToRun, int _totalThreads, int _keyRangeSize, int _tableSize, DataStructureType * _ds) {
-        for (int i=0;i<MAX_THREADS;++i) {
-            rngs[i].setSeed(i+1); // +1 because we don't want thread 0 to get a seed of 0, since seeds of 0 usually mean all random numbers are zero...
+void runExperiment(const benchmark_config_t & cfg, int tableSize, const resize_policy_t & policy, const table_storage_t & storage) {
+    SetBenchmark<DataStructureType>::run(cfg, [&]() {
+        if constexpr (is_constructible<DataStructureType, int, int, resize_policy_t, table_storage_t>::value) {
+            return new DataStructureType(cfg.totalThreads, tableSize, policy, storage);
+        } else if constexpr (is_constructible<DataStructureType, int, int, resize_policy_t>::value) {
+            return new DataStructureType(cfg.totalThreads, tableSize, policy);
+        } else {
+            return new DataStructureType(cfg.totalThreads, tableSize);
         }
-        elapsedMillis = 0;
-        done = false;
-        start = false;
-        running = 0;
-        ds = _ds;
-        millisToRun = _millisToRun;
-        totalThreads = _totalThreads;
-        keyRangeSize = _keyRangeSize;
-        tableSize = _tableSize;
-    }
-    ~globals_t() {
-        delete ds;
-    }
-} __attribute__((aligned(PADDING_BYTES)));
+    });
+}
 
-void printUpdatedThroughput(auto g, int64_t elapsedNow) {
-    auto opsNow = g->numTotalOps.getTotal();
-    cout<<elapsedNow <<"ms: "<<opsNow<<" total_ops"<<endl;
-    cout<<elapsedNow <<"ms: "<<(opsNow * 1000 / elapsedNow)<<" throughput"<<endl;
+// memory usage over repeated grow/shrink cycles: in each cycle, the threads insert every key in [1, keyRangeSize]
+// (each thread inserts a disjoint slice), then erase them all, and the RSS is printed after each phase.
+// if replaced tables are not reclaimed, RSS grows with every cycle.
+template <class DataStructureType>
+void runRSSExperiment(const benchmark_config_t & cfg, int tableSize, int cycles) {
+    auto ds = new DataStructureType(cfg.totalThreads, tableSize);
+    cout<<"rss before cycles="<<getRSSBytes()<<endl;
+    for (int cycle=0;cycle<cycles;++cycle) {
+        for (int phase=0;phase<2;++phase) {
+            atomic<int64_t> sum(0);
+            vector<thread *> threads;
+            for (int tid=0;tid<cfg.totalThreads;++tid) {
+                threads.push_back(new thread([&, tid]() {
+                    binding_bindThread(tid);
+                    int64_t mySum = 0;
+                    for (int key=1+tid;key<=cfg.keyRangeSize;key+=cfg.totalThreads) {
+                        if (phase == 0) mySum += ds->insertIfAbsent(tid, key) ? key : 0;
+                        else mySum -= ds->erase(tid, key) ? key : 0;
+                    }
+                    sum += mySum;
+                }));
+            }
+            for (auto t : threads) {
+                t->join();
+                delete t;
+            }
+            auto expected = (phase == 0) ? (int64_t) cfg.keyRangeSize * (cfg.keyRangeSize + 1) / 2 : 0;
+            auto dsSumOfKeys = ds->getSumOfKeys();
+            cout<<"cycle "<<cycle<<(phase == 0 ? " grow " : " shrink")<<" rss="<<getRSSBytes()<<" sumOfKeys="<<dsSumOfKeys;
+            cout<<((dsSumOfKeys == expected) ? " OK." : " FAILED.")<<endl;
+            if (dsSumOfKeys != expected) {
+                cout<<"ERROR: validation failed!"<<endl;
+                exit(-1);
+            }
+        }
+    }
+    delete ds;
+    cout<<"rss after delete="<<getRSSBytes()<<endl;
 }
 
+// time to build a table from keyRangeSize random keys in [1, keyRangeSize] (so with duplicates):
+// with the bulk load constructor, and by creating a table of the same capacity and inserting the keys with
+// totalThreads threads. the keys are loaded unsorted, then again sorted.
 template <class DataStructureType>
-void runExperiment(int keyRangeSize, int tableSize, int millisToRun, int totalThreads) {
-    // create globals struct that all threads will access (with padding to prevent false sharing on control logic meta data)
-    auto dataStructure = new DataStructureType(totalThreads, tableSize);
-    auto g = new globals_t<DataStructureType>(millisToRun, totalThreads, keyRangeSize, tableSize, dataStructure);
-    
-    /**
-     * 
-     * RUN EXPERIMENT
-     * 
-     */
-    
-    // create and start threads
-    thread * threads[MAX_THREADS]; // just allocate an array for max threads to avoid changing data layout (which can affect results) when varying thread count. the small amount of wasted space is not a big deal.
-    for (int tid=0;tid<g->totalThreads;++tid) {
-        threads[tid] = new thread([&, tid]() { /* access all variables by reference, except tid, which we copy (since we don't want our tid to be a reference to the changing loop variable) */
-                const int OPS_BETWEEN_TIME_CHECKS = 500; // only check the current time (to see if we should stop) once every X operations, to amortize the overhead of time checking
+void runBulkLoadExperiment(const benchmark_config_t & cfg, const resize_policy_t & policy, const table_storage_t & storage) {
+    if constexpr (is_constructible<DataStructureType, int, const vector<int> &, resize_policy_t, table_storage_t, int>::value) {
+        vector<int> keys(cfg.keyRangeSize);
+        PaddedRandom rng(12345);
+        for (auto & key : keys) key = 1 + rng.nextNatural() % cfg.keyRangeSize;
+        auto distinct = keys;
+        sort(distinct.begin(), distinct.end());
+        distinct.erase(unique(distinct.begin(), distinct.end()), distinct.end());
+        int64_t expected = 0;
+        for (auto key : distinct) expected += key;
+        cout<<"keys="<<keys.size()<<" distinct="<<distinct.size()<<" capacity="<<policy.getNewCapacity(keys.size())<<endl;
 
-                // BARRIER WAIT
-                g->running.fetch_add(1);
-                while (!g->start) { TRACE TPRINT("waiting to start"); } // wait to start
-                
-                for (int cnt=0; !g->done; ++cnt) {
-                    if ((cnt % OPS_BETWEEN_TIME_CHECKS) == 0                    // once every X operations
-                        && g->timer.getElapsedMillis() >= g->millisToRun) {   // check how much time has passed
-                            g->done = true; // set global "done" bit flag, so all threads know to stop on the next operation (first guy to stop dictates when everyone else stops --- at most one more operation is performed per thread!)
-                            __sync_synchronize(); // flush the write to g->done so other threads see it immediately (mostly paranoia, since volatile writes should be flushed, and also our next step will be a fetch&add which is an implied flush on intel/amd)
+        for (int sorted=0;sorted<2;++sorted) {
+            if (sorted) sort(keys.begin(), keys.end());
+            for (int bulk=1;bulk>=0;--bulk) {
+                ElapsedTimer timer;
+                timer.startTimer();
+                DataStructureType * ds;
+                if (bulk) {
+                    ds = new DataStructureType(cfg.totalThreads, keys, policy, storage, cfg.totalThreads);
+                } else {
+                    ds = new DataStructureType(cfg.totalThreads, policy.getNewCapacity(keys.size()), policy, storage);
+                    vector<thread *> threads;
+                    for (int tid=0;tid<cfg.totalThreads;++tid) {
+                        threads.push_back(new thread([&, tid]() {
+                            binding_bindThread(tid);
+                            for (size_t i=tid;i<keys.size();i+=cfg.totalThreads) ds->insertIfAbsent(tid, keys[i]);
+                        }));
                     }
-
-                    VERBOSE if (cnt&&((cnt % 1000000) == 0)) TPRINT("op# "<<cnt);
-                    
-                    // flip a coin to decide: insert or erase?
-                    // generate a random double in [0, 1]
-                    double operationType = g->rngs[tid].nextNatural() / (double) numeric_limits<unsigned int>::max();
-                    //cout<<"operationType="<<operationType<<endl;
-                    
-                    // generate random key
-                    int key = 1 + (g->rngs[tid].nextNatural() % g->keyRangeSize);
-                    
-                    // insert or delete this key
-                    if (operationType < 0.5) {
-                        auto result = g->ds->insertIfAbsent(tid, key);
-                        if (result) g->keyChecksum.add(tid, key);
-                    } else {
-                        auto result = g->ds->erase(tid, key);
-                        if (result) g->keyChecksum.add(tid, -key);
+                    for (auto t : threads) {
+                        t->join();
+                        delete t;
                     }
-                    
-                    g->numTotalOps.inc(tid);
                 }
-                
-                g->running.fetch_add(-1);
-                TPRINT("terminated");
-        });
-    }
-
-    while (g->running < g->totalThreads) {
-        TRACE printf("main thread: waiting for threads to START running=%d\n", g->running.load());
-    } // wait for all threads to be ready
-    
-    printf("main thread: starting timer...\n");
-    g->timer.startTimer();
-    __asm__ __volatile__ ("" ::: "memory"); // prevent compiler from reordering "start = true;" before the timer start; this is mostly paranoia, since start is volatile, and nothing should be reordered around volatile reads/writes (by the *compiler*)
-    
-    g->start = true; // release all threads from the barrier, so they can work
-    __sync_synchronize(); // flush store buffer so other threads can see the write to g->start immediately (so they start working ASAP)
-    
-    
-    // wait for all threads to stop working,
-    // and print throughput update every 1s
-    
-    int64_t lastTime = 0;
-    while (g->running > 0) {
-        // sleep for 0.1s
-        timespec time_to_sleep;
-        time_to_sleep.tv_sec = 0;
-        time_to_sleep.tv_nsec = 100000000;
-        nanosleep(&time_to_sleep, NULL);
-        
-        // check if the most recent 0.1s sleep pushed us over a new 1s mark
-        auto elapsedNow = g->timer.getElapsedMillis();
-        if (elapsedNow % 1000 < 100) {
-            printUpdatedThroughput(g, elapsedNow);
+                auto millis = timer.getElapsedMillis();
+                auto dsSumOfKeys = ds->getSumOfKeys();
+                cout<<(sorted ? "sorted  " : "unsorted")<<(bulk ? " bulk load  " : " insert     ")<<" ms="<<millis<<" sumOfKeys="<<dsSumOfKeys;
+                cout<<((dsSumOfKeys == expected) ? " OK." : " FAILED.")<<endl;
+                if (dsSumOfKeys != expected) {
+                    cout<<"ERROR: validation failed!"<<endl;
+                    exit(-1);
+                }
+                delete ds;
+            }
         }
-        lastTime = elapsedNow;
-    }
-    
-    // measure and print elapsed time
-    g->elapsedMillis = g->timer.getElapsedMillis();
-    cout<<(g->elapsedMillis/1000.)<<"s"<<endl;
-    
-    if (g->elapsedMillis - lastTime > 100 && (g->elapsedMillis % 1000) < 100) {
-        printUpdatedThroughput(g, g->elapsedMillis);
-    }
-    
-    // join all threads
-    for (int tid=0;tid<g->totalThreads;++tid) {
-        threads[tid]->join();
-        delete threads[tid];
+    } else {
+        cout<<"ERROR: -bulk is only supported by D"<<endl;
+        exit(1);
     }
-    
-    /**
-     * 
-     * PRODUCE OUTPUT
-     * 
-     * 
-     */
-    
-    g->ds->printDebuggingDetails();
-    
-    auto numTotalOps = g->numTotalOps.getTotal();
-    auto dsSumOfKeys = g->ds->getSumOfKeys();
-    auto threadsSumOfKeys = g->keyChecksum.getTotal();
-    cout<<"Validation: sum of keys according to the data structure = "<<dsSumOfKeys<<" and sum of keys according to the threads = "<<threadsSumOfKeys<<".";
-    cout<<((threadsSumOfKeys == dsSumOfKeys) ? " OK." : " FAILED.")<<endl;
-    cout<<endl;
+}
 
-    if (threadsSumOfKeys != dsSumOfKeys) {
-        cout<<"ERROR: validation failed!"<<endl;
-        exit(-1);
+template <class DataStructureType>
+void runExperiment(const benchmark_config_t & cfg, int tableSize, const resize_policy_t & policy, const table_storage_t & storage,
+        int rssCycles, bool bulkLoad) {
+    if (bulkLoad) {
+        runBulkLoadExperiment<DataStructureType>(cfg, policy, storage);
+    } else if (rssCycles > 0) {
+        runRSSExperiment<DataStructureType>(cfg, tableSize, rssCycles);
+    } else {
+        runExperiment<DataStructureType>(cfg, tableSize, policy, storage);
     }
-    
-    cout<<"individual thread ops :";
-    for (int i=0;i<g->totalThreads;++i) {
-        cout<<" "<<g->numTotalOps.get(i);
+}
+
+// run the experiment with a table that takes its hash function as a template argument (see util.h)
+template <template <class> class DataStructureType>
+void runExperimentWithHash(const char * hash, const benchmark_config_t & cfg, int tableSize, const resize_policy_t & policy,
+        const table_storage_t & storage, int rssCycles, bool bulkLoad) {
+    if (!strcmp(hash, murmur3_hash_t::name)) {
+        runExperiment<DataStructureType<murmur3_hash_t>>(cfg, tableSize, policy, storage, rssCycles, bulkLoad);
+    } else if (!strcmp(hash, multiply_shift_hash_t::name)) {
+        runExperiment<DataStructureType<multiply_shift_hash_t>>(cfg, tableSize, policy, storage, rssCycles, bulkLoad);
+    } else if (!strcmp(hash, crc32c_hash_t::name)) {
+        runExperiment<DataStructureType<crc32c_hash_t>>(cfg, tableSize, policy, storage, rssCycles, bulkLoad);
+    } else if (!strcmp(hash, xxh3_hash_t::name)) {
+        runExperiment<DataStructureType<xxh3_hash_t>>(cfg, tableSize, policy, storage, rssCycles, bulkLoad);
+    } else {
+        cout<<"Bad hash function name: "<<hash<<endl;
+        exit(1);
     }
-    cout<<endl;
-    cout<<"total completed ops   : "<<numTotalOps<<endl;
-    cout<<"throughput            : "<<(long long) (numTotalOps * 1000. / g->elapsedMillis)<<endl;
-    cout<<"elapsed milliseconds  : "<<g->elapsedMillis<<endl;
-    cout<<endl;
-    
-    delete g;
 }
 
 int main(int argc, char** argv) {
     if (argc == 1) {
         cout<<"USAGE: "<<argv[0]<<" [options]"<<endl;
         cout<<"Options:"<<endl;
-        cout<<"    -a  [string]   [a]lgorithm name in { A, B, C, D }"<<endl;
+        cout<<"    -a  [string]   [a]lgorithm name in { A, B, C, D, AS, BS, S, DM }"<<endl;
+        cout<<"                   (AS and BS are A and B with striped locks over densely packed keys,"<<endl;
+        cout<<"                    and S is a lock-free fixed size table with SIMD group probing, like C)"<<endl;
+        cout<<"                   (DM is the 64-bit key/value map version of D, used as a set with value = key)"<<endl;
+        cout<<"                   (C, D and S support contains, and batched operations with -batch; D supports -scan)"<<endl;
+        cout<<"    -hash [string] (C and D only) hash function in { murmur3, multiply_shift, crc32c, xxh3 } (default murmur3)"<<endl;
         cout<<"    -sT [int]      size of initial hash [T]able"<<endl;
         cout<<"    -m  [int]      [m]illiseconds to run"<<endl;
         cout<<"    -sR [int]      size of the key [R]ange that random keys will be drawn from (i.e., range [1, s])"<<endl;
         cout<<"    -t  [int]      number of [t]hreads that will perform inserts and deletes"<<endl;
+        cout<<"    -i  [double]   percent of operations that will be insert (default 50)"<<endl;
+        cout<<"    -d  [double]   percent of operations that will be delete (default 50; insert + delete must be 100)"<<endl;
+        cout<<"    -minLF [double] (D and DM only) shrink the table when fewer than this fraction of its buckets hold live keys (default 0.125, 0 disables)"<<endl;
+        cout<<"    -maxLF [double] (D and DM only) rebuild the table when more than this fraction of its buckets are used (default 0.5)"<<endl;
+        cout<<"    -rss [int]     instead of a timed trial, run [int] grow/shrink cycles and print the resident set size after each"<<endl;
+        cout<<"    -pages [small|transparent|explicit] (D only) page size for bucket arrays (default transparent hugepages)"<<endl;
+        cout<<"    -interleave [0|1] (D only) interleave bucket arrays across NUMA nodes (default 1)"<<endl;
+        cout<<"    -populate [0|1] (D only) fault in the pages of tables created by expansions on the expanding thread (default 0: lazily, by the migrating threads)"<<endl;
+        cout<<"    -bulk [0|1]    (D only) instead of a timed trial, compare the bulk load constructor against inserting with -t threads"<<endl;
+        benchmark_config_t::printUsage();
+        cout<<"    (by default, the table is not prefilled)"<<endl;
         cout<<endl;
         cout<<"Example: "<<argv[0]<<" -a D -m 10000 -sT 1000 -sR 1000000 -t 16"<<endl;
         return 1;
     }
     
-    int millisToRun = -1;
+    benchmark_config_t cfg;
+    cfg.millisToRun = -1;
+    cfg.insertPercent = 50;
+    cfg.deletePercent = 50;
+    cfg.prefill = false;
     int tableSize = 0;
-    int keyRangeSize = 0;
-    int totalThreads = 0;
+    int rssCycles = 0;
+    bool bulkLoad = false;
+    resize_policy_t policy;
+    table_storage_t storage;
     char * alg = NULL;
+    const char * hash = murmur3_hash_t::name;
     
     // read command line args
     for (int i=1;i<argc;++i) {
         if (strcmp(argv[i], "-sT") == 0) {
             tableSize = atoi(argv[++i]);
         } else if (strcmp(argv[i], "-sR") == 0) {
-            keyRangeSize = atoi(argv[++i]);
+            cfg.keyRangeSize = atoi(argv[++i]);
         } else if (strcmp(argv[i], "-t") == 0) {
-            totalThreads = atoi(argv[++i]);
+            cfg.totalThreads = atoi(argv[++i]);
         } else if (strcmp(argv[i], "-m") == 0) {
-            millisToRun = atoi(argv[++i]);
+            cfg.millisToRun = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-i") == 0) {
+            cfg.insertPercent = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-d") == 0) {
+            cfg.deletePercent = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-minLF") == 0) {
+            policy.minLoadFactor = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-maxLF") == 0) {
+            policy.maxLoadFactor = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-rss") == 0) {
+            rssCycles = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-pages") == 0) {
+            char * pages = argv[++i];
+            if (!strcmp(pages, "small")) storage.pages = PAGES_SMALL;
+            else if (!strcmp(pages, "transparent")) storage.pages = PAGES_TRANSPARENT;
+            else if (!strcmp(pages, "explicit")) storage.pages = PAGES_EXPLICIT;
+            else {
+                cout<<"bad page size: "<<pages<<endl;
+                exit(1);
+            }
+        } else if (strcmp(argv[i], "-interleave") == 0) {
+            storage.interleave = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-populate") == 0) {
+            storage.populate = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-bulk") == 0) {
+            bulkLoad = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-hash") == 0) {
+            hash = argv[++i];
         } else if (strcmp(argv[i], "-a") == 0) {
             alg = argv[++i];
-        } else {
+        } else if (!cfg.parseArg(argc, argv, i)) {
             cout<<"bad arguments"<<endl;
             exit(1);
         }
@@ -248,16 +263,26 @@ int main(int argc, char** argv) {
     
     // print configuration for debugging
     PRINT(MAX_THREADS);
-    PRINT(millisToRun);
-    PRINT(keyRangeSize);
+    PRINT(cfg.millisToRun);
+    PRINT(cfg.keyRangeSize);
     PRINT(tableSize);
-    PRINT(totalThreads);
+    PRINT(cfg.totalThreads);
     PRINT(alg);
+    PRINT(hash);
+    PRINT(rssCycles);
+    PRINT(policy.minLoadFactor);
+    PRINT(policy.maxLoadFactor);
+    PRINT(table_storage_t::toString(storage.pages));
+    PRINT(storage.interleave);
+    PRINT(storage.populate);
+    PRINT(bulkLoad);
+    PRINT(cfg.warmupMillis);
+    PRINT(cfg.numTrials);
     cout<<endl;
     
     // check for too large thread count
-    if (totalThreads >= MAX_THREADS) {
-        std::cout<<"ERROR: totalThreads="<<totalThreads<<" >= MAX_THREADS="<<MAX_THREADS<<std::endl;
+    if (cfg.totalThreads >= MAX_THREADS) {
+        std::cout<<"ERROR: totalThreads="<<cfg.totalThreads<<" >= MAX_THREADS="<<MAX_THREADS<<std::endl;
         return 1;
     }
     
@@ -266,24 +291,39 @@ int main(int argc, char** argv) {
         cout<<"Must specify algorithm name"<<endl;
         return 1;
     }
+    cfg.name = alg;
     
     // run experiment for the selected algorithm
+    binding_configurePolicy(cfg.totalThreads);
     if (!strcmp(alg, "A")) {
-        runExperiment<AlgorithmA>(keyRangeSize, tableSize, millisToRun, totalThreads);
+        runExperiment<AlgorithmA>(cfg, tableSize, policy, storage, rssCycles, bulkLoad);
     }
 	else if (!strcmp(alg, "B")) {
-         runExperiment<AlgorithmB>(keyRangeSize, tableSize, millisToRun, totalThreads);
+         runExperiment<AlgorithmB>(cfg, tableSize, policy, storage, rssCycles, bulkLoad);
+    }
+	else if (!strcmp(alg, "AS")) {
+         runExperiment<AlgorithmAStriped>(cfg, tableSize, policy, storage, rssCycles, bulkLoad);
+    }
+	else if (!strcmp(alg, "BS")) {
+         runExperiment<AlgorithmBStriped>(cfg, tableSize, policy, storage, rssCycles, bulkLoad);
     }
 	else if (!strcmp(alg, "C")) {
-         runExperiment<AlgorithmC>(keyRangeSize, tableSize, millisToRun, totalThreads);
+         runExperimentWithHash<AlgorithmC>(hash, cfg, tableSize, policy, storage, rssCycles, bulkLoad);
     }
 	else if (!strcmp(alg, "D")) {
-         runExperiment<AlgorithmD>(keyRangeSize, tableSize, millisToRun, totalThreads);
+         runExperimentWithHash<AlgorithmD>(hash, cfg, tableSize, policy, storage, rssCycles, bulkLoad);
+    }
+	else if (!strcmp(alg, "DM")) {
+         runExperiment<AlgorithmDMap<>>(cfg, tableSize, policy, storage, rssCycles, bulkLoad);
+    }
+	else if (!strcmp(alg, "S")) {
+         runExperiment<AlgorithmSwiss>(cfg, tableSize, policy, storage, rssCycles, bulkLoad);
     }
  	else {
         cout<<"Bad algorithm name: "<<alg<<endl;
         return 1;
     }
+    binding_deinit();
     
     return 0;
 }
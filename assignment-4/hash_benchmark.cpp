@@ -0,0 +1,146 @@
+/**
+ * A micro-benchmark for the hash functions in util.h (the HashFunction template argument of AlgorithmC and AlgorithmD):
+ *  - hashing throughput, in hashes per nanosecond (hashing consecutive integers on one thread), and
+ *  - the distribution of probe lengths (buckets read to find a key) after inserting a set of keys
+ *    into AlgorithmC (fixed capacity, at load factor -load) and AlgorithmD (starting small and growing with its
+ *    default resize policy), for uniform random keys, sequential keys, and clusters of consecutive keys.
+ */
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include <chrono>
+
+#include "util.h"
+#include "alg_c.h"
+#include "alg_d.h"
+
+using namespace std;
+
+enum key_set_t { KEYS_UNIFORM, KEYS_SEQUENTIAL, KEYS_CLUSTERED };
+const char * keySetNames[] = { "uniform", "sequential", "clustered" };
+
+// n keys in [1, 0x3FFFFFFF] (the largest key AlgorithmD allows).
+// clustered keys are runs of clusterSize consecutive keys, starting at random keys.
+vector<int> makeKeys(key_set_t keySet, int n, int clusterSize) {
+    vector<int> keys(n);
+    PaddedRandom rng(12345);
+    for (int i=0;i<n;++i) {
+        switch (keySet) {
+            case KEYS_UNIFORM: keys[i] = 1 + rng.nextNatural() % 0x3FFFFFFE; break;
+            case KEYS_SEQUENTIAL: keys[i] = i + 1; break;
+            case KEYS_CLUSTERED:
+                keys[i] = (i % clusterSize == 0) ? 1 + rng.nextNatural() % (0x3FFFFFFF - clusterSize) : keys[i-1] + 1;
+                break;
+        }
+    }
+    return keys;
+}
+
+template <class HashFunction>
+double hashesPerNanosecond(int64_t numHashes) {
+    auto start = chrono::high_resolution_clock::now();
+    uint32_t sum = 0;
+    for (int64_t i=0;i<numHashes;++i) {
+        sum += HashFunction::hash((uint32_t) i);
+    }
+    auto nanos = chrono::duration_cast<chrono::nanoseconds>(chrono::high_resolution_clock::now() - start).count();
+    volatile uint32_t sink = sum; // so the loop is not optimized away
+    (void) sink;
+    return (double) numHashes / nanos;
+}
+
+// print the mean, some percentiles, the maximum, and the fraction of keys in power of two ranges of probe lengths
+void printProbeLengths(const char * hash, const char * keySet, const char * table, int64_t capacity, const vector<int64_t> & histogram) {
+    int64_t keys = 0, total = 0;
+    for (size_t p=0;p<histogram.size();++p) {
+        keys += histogram[p];
+        total += p * histogram[p];
+    }
+    auto percentile = [&](double fraction) {
+        int64_t seen = 0;
+        for (size_t p=0;p<histogram.size();++p) {
+            seen += histogram[p];
+            if (seen >= fraction * keys) return (int64_t) p;
+        }
+        return (int64_t) histogram.size() - 1;
+    };
+    cout<<"hash="<<hash<<" keys="<<keySet<<" table="<<table<<" capacity="<<capacity<<" live="<<keys;
+    cout<<" avg="<<(keys ? (double) total / keys : 0)<<" p50="<<percentile(0.5)<<" p99="<<percentile(0.99);
+    cout<<" p999="<<percentile(0.999)<<" max="<<histogram.size()-1;
+    cout<<" distribution:";
+    for (size_t lo=1;lo<histogram.size();lo*=2) {
+        int64_t count = 0;
+        for (size_t p=lo;p<min(histogram.size(), 2*lo);++p) count += histogram[p];
+        cout<<" ["<<lo<<","<<2*lo-1<<"]="<<(double) count / keys;
+    }
+    cout<<endl;
+}
+
+template <class HashFunction>
+void runHash(int n, double loadFactor, int clusterSize, int64_t numHashes) {
+    cout<<"hash="<<HashFunction::name<<" hashes_per_ns="<<hashesPerNanosecond<HashFunction>(numHashes)<<endl;
+    for (int keySet=KEYS_UNIFORM;keySet<=KEYS_CLUSTERED;++keySet) {
+        auto keys = makeKeys((key_set_t) keySet, n, clusterSize);
+        {
+            const int capacity = n / loadFactor;
+            AlgorithmC<HashFunction> c(1, capacity);
+            for (auto key : keys) c.insertIfAbsent(0, key);
+            vector<int64_t> histogram;
+            c.addProbeLengths(histogram);
+            printProbeLengths(HashFunction::name, keySetNames[keySet], "C", capacity, histogram);
+        }
+        {
+            resize_policy_t policy;
+            policy.minCapacity = 1024;
+            AlgorithmD<HashFunction> d(1, 1024, policy);
+            for (auto key : keys) d.insertIfAbsent(0, key);
+            vector<int64_t> histogram;
+            d.addProbeLengths(histogram);
+            printProbeLengths(HashFunction::name, keySetNames[keySet], "D", d.getCapacity(), histogram);
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    int n = 1000000;
+    double loadFactor = 0.5;
+    int clusterSize = 64;
+    int64_t numHashes = 1LL<<28;
+    const char * hash = NULL;
+
+    for (int i=1;i<argc;++i) {
+        if (strcmp(argv[i], "-n") == 0) {
+            n = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-load") == 0) {
+            loadFactor = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-cluster") == 0) {
+            clusterSize = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-hashes") == 0) {
+            numHashes = atoll(argv[++i]);
+        } else if (strcmp(argv[i], "-hash") == 0) {
+            hash = argv[++i];
+        } else {
+            cout<<"USAGE: "<<argv[0]<<" [options]"<<endl;
+            cout<<"Options:"<<endl;
+            cout<<"    -n [int]         number of keys inserted into each table (default 1000000)"<<endl;
+            cout<<"    -load [double]   load factor of AlgorithmC after the inserts (default 0.5)"<<endl;
+            cout<<"    -cluster [int]   number of consecutive keys in each cluster of clustered keys (default 64)"<<endl;
+            cout<<"    -hashes [int]    number of hashes computed to measure throughput (default 2^28)"<<endl;
+            cout<<"    -hash [string]   only run this hash function (default: all of murmur3, multiply_shift, crc32c, xxh3)"<<endl;
+            return 1;
+        }
+    }
+    PRINT(n);
+    PRINT(loadFactor);
+    PRINT(clusterSize);
+    PRINT(numHashes);
+    cout<<endl;
+
+    if (!hash || !strcmp(hash, murmur3_hash_t::name)) runHash<murmur3_hash_t>(n, loadFactor, clusterSize, numHashes);
+    if (!hash || !strcmp(hash, multiply_shift_hash_t::name)) runHash<multiply_shift_hash_t>(n, loadFactor, clusterSize, numHashes);
+    if (!hash || !strcmp(hash, crc32c_hash_t::name)) runHash<crc32c_hash_t>(n, loadFactor, clusterSize, numHashes);
+    if (!hash || !strcmp(hash, xxh3_hash_t::name)) runHash<xxh3_hash_t>(n, loadFactor, clusterSize, numHashes);
+    return 0;
+}
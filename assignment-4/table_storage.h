@@ -0,0 +1,105 @@
+#pragma once
+#include <sys/mman.h>
+#include <unistd.h>
+#include <numa.h>
+#include <omp.h>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+using namespace std;
+
+/**
+ * mmap based storage for large bucket arrays.
+ *
+ * anonymous mmap memory is already zero, so a table whose EMPTY bucket is all zero bits needs no zeroing loop:
+ * the only cost is faulting the pages in, and where that happens decides which NUMA node each page lives on.
+ * allocTableStorage faults pages in one of three ways:
+ *  - in parallel (touchThreads > 0): every page is written once by a team of OpenMP threads,
+ *    which is how a multi-GB table should be created at startup.
+ *  - on the calling thread (populate), which writes every page once before returning.
+ *  - lazily, by whichever thread first writes each page. this is the right choice for a table that is filled
+ *    by a cooperative migration, since the migrating threads then fault its pages in in parallel.
+ * pages are never faulted in by mmap itself (MAP_POPULATE), since they would then be small pages before madvise
+ * could ask for hugepages, and placed before mbind could interleave them. if interleave is set and there are
+ * several NUMA nodes, pages are placed round robin across all nodes whichever thread faults them in.
+ */
+
+enum table_pages_t {
+    PAGES_SMALL,            // ordinary (4KB) pages
+    PAGES_TRANSPARENT,      // ask for transparent hugepages with madvise(MADV_HUGEPAGE)
+    PAGES_EXPLICIT          // hugetlbfs pages (MAP_HUGETLB), falling back to PAGES_TRANSPARENT if none are reserved
+};
+
+struct table_storage_t {
+    table_pages_t pages = PAGES_TRANSPARENT;
+    bool interleave = true;
+    bool populate = false;  // fault pages in on the calling thread (only used when pages are not touched in parallel)
+
+    static const char * toString(table_pages_t pages) {
+        switch (pages) {
+            case PAGES_SMALL: return "small";
+            case PAGES_TRANSPARENT: return "transparent";
+            default: return "explicit";
+        }
+    }
+};
+
+#define TABLE_STORAGE_HUGE_PAGE_BYTES ((size_t) 2 << 20)
+
+inline size_t roundUpToMultiple(size_t bytes, size_t multiple) {
+    return (bytes + multiple - 1) / multiple * multiple;
+}
+
+/**
+ * allocate zeroed storage for at least bytes bytes (as described above).
+ * *mappedBytes is set to the length of the mapping, which must be passed to freeTableStorage.
+ * exits the program if the memory cannot be mapped (like a failed new[] in the tables that use this).
+ */
+inline void * allocTableStorage(size_t bytes, const table_storage_t & storage, int touchThreads, size_t * mappedBytes) {
+    const size_t smallPageBytes = sysconf(_SC_PAGESIZE);
+    void * p = MAP_FAILED;
+    size_t touchStride = smallPageBytes;
+
+    const int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+    if (storage.pages == PAGES_EXPLICIT) {
+        *mappedBytes = roundUpToMultiple(bytes, TABLE_STORAGE_HUGE_PAGE_BYTES);
+        p = mmap(NULL, *mappedBytes, PROT_READ | PROT_WRITE, flags | MAP_HUGETLB, -1, 0);
+        touchStride = TABLE_STORAGE_HUGE_PAGE_BYTES;
+        if (p == MAP_FAILED) {
+            static atomic<bool> warned(false);
+            if (!warned.exchange(true)) cout<<"WARNING: no explicit hugepages available (see /proc/sys/vm/nr_hugepages); using transparent hugepages"<<endl;
+        }
+    }
+    if (p == MAP_FAILED) {
+        *mappedBytes = roundUpToMultiple(bytes, smallPageBytes);
+        p = mmap(NULL, *mappedBytes, PROT_READ | PROT_WRITE, flags, -1, 0);
+        touchStride = smallPageBytes;
+        if (p != MAP_FAILED && storage.pages != PAGES_SMALL) madvise(p, *mappedBytes, MADV_HUGEPAGE);
+    }
+    if (p == MAP_FAILED) {
+        cout<<"ERROR: could not mmap "<<bytes<<" bytes of table storage"<<endl;
+        exit(3);
+    }
+
+    // mbind only changes the policy of this mapping, not the calling thread's policy
+    const bool interleave = storage.interleave && numa_available() != -1 && numa_num_configured_nodes() > 1;
+    if (interleave) numa_interleave_memory(p, *mappedBytes, numa_all_nodes_ptr);
+
+    if (touchThreads <= 0 && storage.populate) touchThreads = 1; // on the calling thread
+    if (touchThreads > 0) {
+        // write one byte per page. the memory is already zero, so this only decides where the pages live.
+        // with transparent hugepages, the first write to a 2MB region faults in the whole region.
+        volatile char * bytesToTouch = (volatile char *) p;
+        const int64_t numPages = *mappedBytes / touchStride;
+        #pragma omp parallel for num_threads(touchThreads) schedule(static)
+        for (int64_t i = 0; i < numPages; ++i) {
+            bytesToTouch[i * touchStride] = 0;
+        }
+    }
+    return p;
+}
+
+inline void freeTableStorage(void * p, size_t mappedBytes) {
+    if (p) munmap(p, mappedBytes);
+}
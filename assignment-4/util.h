@@ -4,6 +4,8 @@
 #include <chrono>
 #include <atomic>
 #include <sstream>
+#include <algorithm>
+#include <nmmintrin.h> // _mm_crc32_u32 (needs -msse4.2)
 using namespace std;
 
 #ifndef MAX_THREADS
@@ -54,13 +56,19 @@ public:
     counter(int _numThreads) : numThreads(_numThreads), globalCounter(0) {
         for (int i=0;i<MAX_THREADS;++i) subcounters[i].v = 0;
     }
+    // returns the amount added to the global counter (0 unless this increment flushed the subcounter)
     int64_t inc(int tid) {
         auto val = ++subcounters[tid].v;
         if (val >= max(1000, 30*numThreads)) {
             globalCounter.fetch_add(val);
             subcounters[tid].v = 0;
+            return val;
         }
-        return -1; // dummy return value
+        return 0;
+    }
+    // add n directly to the global counter (e.g., for keys placed without going through inc)
+    void add(int64_t n) {
+        globalCounter.fetch_add(n);
     }
     int64_t get() {
         return globalCounter;
@@ -181,5 +189,67 @@ uint32_t murmur3(uint32_t key) {
     return h;
 }
 
+/**
+ * hash functions that can be given to the hash tables as a template argument (HashFunction::hash(key)).
+ * all of them map 32-bit keys to 32-bit hashes, which the tables reduce modulo their capacity.
+ */
+
+// the murmur3 32-bit hash of a single word (above)
+struct murmur3_hash_t {
+    static constexpr const char * name = "murmur3";
+    static inline uint32_t hash(uint32_t key) { return murmur3(key); }
+};
+
+// multiply-shift: the high half of key times an odd 64-bit constant (the cheapest mixer; its low bits are weak,
+// but the high half of the product depends on every bit of the key)
+struct multiply_shift_hash_t {
+    static constexpr const char * name = "multiply_shift";
+    static inline uint32_t hash(uint32_t key) { return (uint32_t) ((key * 0x9E3779B97F4A7C15ULL) >> 32); }
+};
+
+// hardware CRC32C (SSE4.2): one instruction with 3 cycle latency, but a linear function of the key
+struct crc32c_hash_t {
+    static constexpr const char * name = "crc32c";
+    static inline uint32_t hash(uint32_t key) { return _mm_crc32_u32(0xFFFFFFFF, key); }
+};
+
+// the 4 to 8 byte path of XXH3 (64-bit), specialized to a 4-byte input with a fixed secret, folded to 32 bits
+struct xxh3_hash_t {
+    static constexpr const char * name = "xxh3";
+    static inline uint32_t hash(uint32_t key) {
+        constexpr uint64_t bitflip = 0x1CAD21F72C81017CULL ^ 0xDB979083E96DD4DEULL;
+        constexpr uint64_t prime = 0x9FB21C651E98DF25ULL;
+        uint64_t h = (key + ((uint64_t) key << 32)) ^ bitflip;
+        h ^= ((h << 49) | (h >> 15)) ^ ((h << 24) | (h >> 40));
+        h *= prime;
+        h ^= (h >> 35) + 4;
+        h *= prime;
+        h ^= h >> 28;
+        return (uint32_t) (h ^ (h >> 32));
+    }
+};
+
+#ifndef MAX_BATCH_SIZE
+#define MAX_BATCH_SIZE 64
+#endif
+
+// helper for batched operations: for each group of at most MAX_BATCH_SIZE keys, hash every key and call
+// prefetch(h) to prefetch its home bucket (so the cache misses of the whole group overlap), then set
+// results[i] = op(keys[i], h) for each key in the group.
+template <class HashFunction = murmur3_hash_t, class Prefetch, class Op>
+void runBatch(const int * keys, const int n, bool * results, Prefetch prefetch, Op op) {
+    uint32_t h[MAX_BATCH_SIZE];
+    for (int start = 0; start < n; start += MAX_BATCH_SIZE) {
+        const int size = min(n - start, MAX_BATCH_SIZE);
+        for (int i=0;i<size;++i) {
+            h[i] = HashFunction::hash(keys[start+i]);
+            prefetch(h[i]);
+        }
+        for (int i=0;i<size;++i) {
+            results[start+i] = op(keys[start+i], h[i]);
+        }
+    }
+}
+
 #endif /* UTIL_H */
 
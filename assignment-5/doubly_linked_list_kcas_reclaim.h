@@ -14,7 +14,7 @@ private:
 
     Node * head;
     Node * tail;
-    KCASLockFree<5> kcas;
+    KCASLockFree<DLL_KCAS_MAX_K, DLL_KCAS_MAX_WIDE_K> kcas;
     simple_record_manager<Node> * recmgr;
 
 public:
@@ -26,8 +26,44 @@ public:
     bool insertIfAbsent(const int tid, const int & key); // try to insert key; return true if successful (if it doesn't already exist), false otherwise
     bool erase(const int tid, const int & key); // try to erase key; return true if successful, false otherwise
     
+    // atomically read the keys in [lo, hi] into out (in increasing order), and return how many there are.
+    // out must have room for hi - lo + 1 keys. returns -1 (and reads nothing) if the range is wider than
+    // rangeQueryMaxKeys keys, since its nodes could not be validated with one kcas.
+    int rangeQuery(const int tid, const int & lo, const int & hi, int * out);
+    static const int rangeQueryMaxKeys = DLL_RANGE_QUERY_MAX_KEYS;
+
     long getSumOfKeys(); // should return the sum of all keys in the set
     void printDebuggingDetails(); // print any debugging details you want at the end of a trial in this function
+
+    /**
+     * a cursor that moves over the keys of the list in either direction.
+     * each step is linearizable: it moves to the key that immediately follows (or precedes) the cursor's key
+     * at some point during the step. a sequence of steps is not a snapshot of the list (use rangeQuery for that).
+     * the cursor can also be before the first key or after the last key (where valid() is false).
+     * the cursor holds a memory reclamation guard for thread tid, so while it exists, tid must not call
+     * other operations of the list (and should not hold it for long, since it delays reclamation).
+     */
+    class Cursor {
+        DoublyLinkedListReclaim * const list;
+        const int tid;
+        simple_record_manager<Node>::MemoryReclamationGuard guard;
+        Node * node;
+    public:
+        Cursor(DoublyLinkedListReclaim * _list, const int _tid, const int & key)  // positioned at the smallest key >= key
+                : list(_list), tid(_tid), guard(_list->recmgr->getGuard(_tid)), node(_list->seek(_tid, key)) {}
+        bool valid() { return node != list->head && node != list->tail; }
+        int key() { assert(valid()); return node->val; }
+        void next() { if (node != list->tail) node = list->successor(tid, node); }
+        void prev() { if (node != list->head) node = list->predecessor(tid, node); }
+    };
+
+private:
+    bool validateChain(const int tid, Node * const * chain, const int n);
+    template <int K>
+    bool validateChain(const int tid, kcasdesc_t<K> * descPtr, Node * const * chain, const int n);
+    Node * seek(const int tid, const int & key);
+    Node * successor(const int tid, Node * node);
+    Node * predecessor(const int tid, Node * node);
 };
 
 DoublyLinkedListReclaim::DoublyLinkedListReclaim(const int _numThreads, const int _minKey, const int _maxKey)
@@ -102,8 +138,8 @@ bool DoublyLinkedListReclaim::insertIfAbsent(const int tid, const int & key) {
 
         auto descPtr = kcas.getDescriptor(tid);
 
-        descPtr->addValAddr(&pred->mark, (casword_t) false, (casword_t) false);
-        descPtr->addValAddr(&succ->mark, (casword_t) false, (casword_t) false);
+        descPtr->addValAddrReadOnly(&pred->mark, (casword_t) false);
+        descPtr->addValAddrReadOnly(&succ->mark, (casword_t) false);
         
         descPtr->addPtrAddr(&pred->next, (casword_t) succ, (casword_t) n);
         descPtr->addPtrAddr(&succ->prev, (casword_t) pred, (casword_t) n);
@@ -130,9 +166,9 @@ bool DoublyLinkedListReclaim::erase(const int tid, const int & key) {
         Node * after = (Node *) kcas.readPtr(tid, &succ->next);
         auto descPtr = kcas.getDescriptor(tid);
 
-        descPtr->addValAddr(&pred->mark, (casword_t) false, (casword_t) false);
+        descPtr->addValAddrReadOnly(&pred->mark, (casword_t) false);
+        descPtr->addValAddrReadOnly(&after->mark, (casword_t) false);
         descPtr->addValAddr(&succ->mark, (casword_t) false, (casword_t) true);
-        descPtr->addValAddr(&after->mark, (casword_t) false, (casword_t) false);
 
         descPtr->addPtrAddr(&pred->next, (casword_t) succ, (casword_t) after);
         descPtr->addPtrAddr(&after->prev, (casword_t) succ, (casword_t) pred);
@@ -146,6 +182,74 @@ bool DoublyLinkedListReclaim::erase(const int tid, const int & key) {
     assert(false);
 }
 
+// atomically check that chain[0] is in the list, and that chain[i]->next == chain[i+1] for i < n-1
+// (so all of chain is in the list, consecutively). the next pointers are locked (with old == new) rather than
+// being read-only entries, because they can change and change back (when a node is inserted and erased)
+// and must be unchanged at a single point in time. a chain that is too long for an ordinary descriptor
+// (n entries) uses a wide descriptor.
+bool DoublyLinkedListReclaim::validateChain(const int tid, Node * const * chain, const int n) {
+    if (n <= DLL_KCAS_MAX_K) return validateChain(tid, kcas.getDescriptor(tid), chain, n);
+    return validateChain(tid, kcas.getWideDescriptor(tid), chain, n);
+}
+
+template <int K>
+bool DoublyLinkedListReclaim::validateChain(const int tid, kcasdesc_t<K> * descPtr, Node * const * chain, const int n) {
+    descPtr->addValAddrReadOnly(&chain[0]->mark, (casword_t) false);
+    for (int i = 0; i + 1 < n; i++) {
+        descPtr->addPtrAddr(&chain[i]->next, (casword_t) chain[i+1], (casword_t) chain[i+1]);
+    }
+    return kcas.execute(tid, descPtr);
+}
+
+int DoublyLinkedListReclaim::rangeQuery(const int tid, const int & lo, const int & hi, int * out) {
+    assert(lo >= minKey && hi <= maxKey);
+    if ((int64_t) hi - lo + 1 > DLL_RANGE_QUERY_MAX_KEYS) return -1;
+    auto guard = recmgr->getGuard(tid);
+    Node * chain[DLL_RANGE_QUERY_MAX_KEYS + 2];
+    while (true) {
+        auto [pred, succ] = internalSearch(tid, lo);
+        int n = 0;
+        chain[n++] = pred;
+        Node * curr = succ;
+        while (curr->val <= hi) { // keys increase along next pointers (even from erased nodes), so n stays in bounds
+            assert(n <= DLL_RANGE_QUERY_MAX_KEYS);
+            chain[n++] = curr;
+            curr = (Node *) kcas.readPtr(tid, &curr->next);
+        }
+        chain[n++] = curr;
+        if (!validateChain(tid, chain, n)) continue;
+        for (int i = 1; i < n - 1; i++) {
+            out[i - 1] = chain[i]->val;
+        }
+        return n - 2;
+    }
+}
+
+// the node with the smallest key >= key (which may be tail)
+Node * DoublyLinkedListReclaim::seek(const int tid, const int & key) {
+    while (true) {
+        auto [pred, succ] = internalSearch(tid, key);
+        Node * chain[2] = {pred, succ};
+        if (validateChain(tid, chain, 2)) return succ;
+    }
+}
+
+Node * DoublyLinkedListReclaim::successor(const int tid, Node * node) {
+    Node * chain[2] = {node, (Node *) kcas.readPtr(tid, &node->next)};
+    if (validateChain(tid, chain, 2)) return chain[1];
+    return seek(tid, node->val + 1); // node was erased
+}
+
+Node * DoublyLinkedListReclaim::predecessor(const int tid, Node * node) {
+    Node * chain[2] = {(Node *) kcas.readPtr(tid, &node->prev), node};
+    while (!validateChain(tid, chain, 2)) {
+        auto [pred, succ] = internalSearch(tid, node->val); // node was erased, or a key was inserted before it
+        chain[0] = pred;
+        chain[1] = succ;
+    }
+    return chain[0];
+}
+
 long DoublyLinkedListReclaim::getSumOfKeys() {
     auto guard = recmgr->getGuard(0);
     Node * temp = (Node *) kcas.readPtr(0, &head->next);
@@ -158,5 +262,5 @@ long DoublyLinkedListReclaim::getSumOfKeys() {
 }
 
 void DoublyLinkedListReclaim::printDebuggingDetails() {
-    
+    kcas.printStats();
 }
@@ -4,6 +4,7 @@
 #include <stdint.h>
 #include <sstream>
 #include <cstring>
+#include <algorithm>
 using namespace std;
 
 /**
@@ -142,10 +143,25 @@ typedef intptr_t seqbits_t;
 
 #define RDCSS_TAGBIT 0x1
 #define KCAS_TAGBIT 0x2
+#define KCAS_WIDE_TAGBIT 0x4 // set (with KCAS_TAGBIT) in a pointer to a wide descriptor (see KCASLockFree)
 
 #define KCAS_STATE_UNDECIDED 0
 #define KCAS_STATE_SUCCEEDED 4
 #define KCAS_STATE_FAILED 8
+#define KCAS_STATE_READ_CHECK 12
+
+// compile with -DKCAS_STATS=if\(1\) to count the CAS instructions performed by KCAS operations (see printStats)
+#ifndef KCAS_STATS
+#define KCAS_STATS if(0)
+#endif
+
+// if true, read-only entries are locked and written back like other entries (for comparison with read-only validation)
+bool kcasLockReadOnlyEntries = false;
+
+// wide descriptors can only be used by threads with tid < KCAS_WIDE_TIDS
+#ifndef KCAS_WIDE_TIDS
+#define KCAS_WIDE_TIDS 256 // MAX_THREADS in defines.h
+#endif
 
 #define KCAS_LEFTSHIFT 2
 
@@ -166,13 +182,31 @@ struct kcasentry_t { // just part of kcasdesc_t, not a standalone descriptor
     casword_t newval;
 };
 
+/**
+ * a kcas descriptor has numEntries entries that are changed (entries[0 .. numEntries)),
+ * and numReadOnly read-only entries, which are stored from the end of entries (entries[MAX_K-numReadOnly .. MAX_K)).
+ *
+ * a read-only entry (with oldval == newval) is never locked: it is validated by reading it once every other
+ * entry is locked, in the READ_CHECK state (as in Fraser's OSTM). an address must not be both a read-only
+ * entry and a changed entry of the same kcas.
+ * read-only words CAN change and change back while a kcas reads them (e.g., a node's next or child pointer goes
+ * A -> B -> A when B is inserted and then erased), so read-only entries rely on a different invariant: every kcas
+ * that changes a word that some kcas reads as a read-only entry must also change or validate a word that the
+ * reading kcas locks (in the skip list and the tree, a kcas that reads a node's next or child pointer locks the
+ * node's mark, and every change to that pointer validates the mark). a writer of a read-only word therefore
+ * conflicts with the reading kcas while it holds its locks, so the word cannot change between the reading kcas's
+ * transition to READ_CHECK and its read check.
+ * a kcas with read-only entries can fail spuriously if it conflicts with another kcas that is validating its
+ * read-only entries (as a weak CAS can), so it should be retried by the caller.
+ */
 template <int MAX_K>
 class kcasdesc_t {
 public:
     volatile seqbits_t seqBits;
     casword_t numEntries;
+    casword_t numReadOnly;
     kcasentry_t entries[MAX_K];
-    const static int size = sizeof(seqBits)+sizeof(numEntries)+sizeof(entries);
+    const static int size = sizeof(seqBits)+sizeof(numEntries)+sizeof(numReadOnly)+sizeof(entries);
     volatile char padding[128+((64-size%64)%64)]; // add padding to prevent false sharing
     
     void addValAddr(casword_t * addr, casword_t oldval, casword_t newval) {
@@ -180,7 +214,7 @@ public:
         entries[numEntries].oldval = oldval << KCAS_LEFTSHIFT;
         entries[numEntries].newval = newval << KCAS_LEFTSHIFT;
         ++numEntries;
-        assert(numEntries <= MAX_K);
+        assert(numEntries + numReadOnly <= MAX_K);
     }
     
     void addPtrAddr(casword_t * addr, casword_t oldval, casword_t newval) {
@@ -188,12 +222,34 @@ public:
         entries[numEntries].oldval = oldval;
         entries[numEntries].newval = newval;
         ++numEntries;
-        assert(numEntries <= MAX_K);
+        assert(numEntries + numReadOnly <= MAX_K);
+    }
+
+    void addValAddrReadOnly(casword_t * addr, casword_t val) {
+        addPtrAddrReadOnly(addr, val << KCAS_LEFTSHIFT);
+    }
+
+    void addPtrAddrReadOnly(casword_t * addr, casword_t val) {
+        ++numReadOnly;
+        assert(numEntries + numReadOnly <= MAX_K);
+        entries[MAX_K - numReadOnly].addr = addr;
+        entries[MAX_K - numReadOnly].oldval = val;
+        entries[MAX_K - numReadOnly].newval = val;
     }
 };
 
-template <int MAX_K>
+/**
+ * KCASLockFree<MAX_K> performs kcas operations with up to MAX_K entries.
+ * KCASLockFree<MAX_K, MAX_WIDE_K> can also perform kcas operations with up to MAX_WIDE_K > MAX_K entries,
+ * using the wide descriptors returned by getWideDescriptor (e.g., to validate a long chain of nodes).
+ * these are stored separately (with a tag bit in pointers to them), so ordinary kcas operations (and the
+ * snapshots of their descriptors taken by helpers) keep the size given by MAX_K.
+ */
+template <int MAX_K, int MAX_WIDE_K = 0>
 class KCASLockFree {
+    static_assert(MAX_WIDE_K == 0 || MAX_WIDE_K > MAX_K, "wide descriptors must have more entries than ordinary ones");
+    static constexpr int WIDE_K = MAX_WIDE_K ? MAX_WIDE_K : 1;
+
     /**
      * Data definitions
      */
@@ -209,8 +265,16 @@ private:
     volatile char __padding_desc[128];
     kcasdesc_t<MAX_K> kcasDescriptors[LAST_TID+1] __attribute__ ((aligned(64)));
     rdcssdesc_t rdcssDescriptors[LAST_TID+1] __attribute__ ((aligned(64)));
+    kcasdesc_t<WIDE_K> wideDescriptors[MAX_WIDE_K ? KCAS_WIDE_TIDS : 1] __attribute__ ((aligned(64)));
     volatile char __padding_desc3[128];
 
+    struct kcasstats_t {
+        long long executions;
+        long long cas;          // CAS instructions on data words and descriptors
+        volatile char padding[64-2*sizeof(long long)];
+    };
+    kcasstats_t stats[LAST_TID+1] __attribute__ ((aligned(64)));
+
     /**
      * Function declarations
      */
@@ -220,10 +284,23 @@ public:
     void writeInitVal(const int tid, casword_t volatile * addr, casword_t const newval);
     casword_t readPtr(const int tid, casword_t volatile * addr);
     casword_t readVal(const int tid, casword_t volatile * addr);
-    bool execute(const int tid, kcasptr_t ptr);
+    template <int K>
+    bool execute(const int tid, kcasdesc_t<K> * ptr);
     kcasptr_t getDescriptor(const int tid);
+    kcasdesc_t<WIDE_K> * getWideDescriptor(const int tid);
+    void printStats();
 private:
-    bool help(const int tid, kcastagptr_t tagptr, kcasptr_t ptr, bool helpingOther);
+    template <int K>
+    kcasdesc_t<K> * descriptors();
+    template <int K>
+    bool help(const int tid, kcastagptr_t tagptr, kcasdesc_t<K> * snapshot, bool helpingOther);
+    template <int K>
+    bool readCheck(const int tid, kcastagptr_t tagptr, kcasdesc_t<K> * snapshot);
+    casword_t readForReadCheck(const int tid, kcastagptr_t tagptr, casword_t volatile * addr);
+    template <int K>
+    bool readForReadCheckOther(const int tid, kcastagptr_t tagptr, casword_t volatile * addr, casword_t val, casword_t * result);
+    void helpOther(const int tid, kcastagptr_t tagptr);
+    template <int K>
     void helpOther(const int tid, kcastagptr_t tagptr);
     casword_t rdcssRead(const int tid, casword_t volatile * addr);
     casword_t rdcss(const int tid, rdcssptr_t ptr, rdcsstagptr_t tagptr);
@@ -239,8 +316,8 @@ static bool isKcas(casword_t val) {
     return (val & KCAS_TAGBIT);
 }
 
-template <int MAX_K>
-void KCASLockFree<MAX_K>::rdcssHelp(rdcsstagptr_t tagptr, rdcssptr_t snapshot, bool helpingOther) {
+template <int MAX_K, int MAX_WIDE_K>
+void KCASLockFree<MAX_K, MAX_WIDE_K>::rdcssHelp(rdcsstagptr_t tagptr, rdcssptr_t snapshot, bool helpingOther) {
     bool readSuccess;
     casword_t v = DESC_READ_FIELD(readSuccess, *snapshot->addr1, snapshot->old1, KCAS_SEQBITS_MASK_STATE, KCAS_SEQBITS_OFFSET_STATE);
     if (!readSuccess) v = KCAS_STATE_SUCCEEDED; // return;
@@ -253,8 +330,8 @@ void KCASLockFree<MAX_K>::rdcssHelp(rdcsstagptr_t tagptr, rdcssptr_t snapshot, b
     }
 }
 
-template <int MAX_K>
-void KCASLockFree<MAX_K>::rdcssHelpOther(rdcsstagptr_t tagptr) {
+template <int MAX_K, int MAX_WIDE_K>
+void KCASLockFree<MAX_K, MAX_WIDE_K>::rdcssHelpOther(rdcsstagptr_t tagptr) {
     rdcssdesc_t newSnapshot;
     const int sz = rdcssdesc_t::size;
     if (DESC_SNAPSHOT(rdcssdesc_t, rdcssDescriptors, &newSnapshot, tagptr, sz)) {
@@ -262,21 +339,25 @@ void KCASLockFree<MAX_K>::rdcssHelpOther(rdcsstagptr_t tagptr) {
     }
 }
 
-template <int MAX_K>
-casword_t KCASLockFree<MAX_K>::rdcss(const int tid, rdcssptr_t ptr, rdcsstagptr_t tagptr) {
+template <int MAX_K, int MAX_WIDE_K>
+casword_t KCASLockFree<MAX_K, MAX_WIDE_K>::rdcss(const int tid, rdcssptr_t ptr, rdcsstagptr_t tagptr) {
     casword_t r;
     do {
+        KCAS_STATS ++stats[tid].cas;
         r = VAL_CAS(ptr->addr2, ptr->old2, (casword_t) tagptr);
         if (isRdcss(r)) {
             rdcssHelpOther((rdcsstagptr_t) r);
         }
     } while (isRdcss(r));
-    if (r == ptr->old2) rdcssHelp(tagptr, ptr, false); // finish our own operation
+    if (r == ptr->old2) {
+        KCAS_STATS ++stats[tid].cas;
+        rdcssHelp(tagptr, ptr, false); // finish our own operation
+    }
     return r;
 }
 
-template <int MAX_K>
-casword_t KCASLockFree<MAX_K>::rdcssRead(const int tid, casword_t volatile * addr) {
+template <int MAX_K, int MAX_WIDE_K>
+casword_t KCASLockFree<MAX_K, MAX_WIDE_K>::rdcssRead(const int tid, casword_t volatile * addr) {
     casword_t r;
     do {
         r = *addr;
@@ -287,29 +368,57 @@ casword_t KCASLockFree<MAX_K>::rdcssRead(const int tid, casword_t volatile * add
     return r;
 }
 
-template <int MAX_K>
-KCASLockFree<MAX_K>::KCASLockFree() {
+template <int MAX_K, int MAX_WIDE_K>
+KCASLockFree<MAX_K, MAX_WIDE_K>::KCASLockFree() {
     DESC_INIT_ALL(kcasDescriptors, KCAS_SEQBITS_NEW);
     DESC_INIT_ALL(rdcssDescriptors, RDCSS_SEQBITS_NEW);
+    for (int i = 0; i < (MAX_WIDE_K ? KCAS_WIDE_TIDS : 1); ++i) {
+        wideDescriptors[i].seqBits = KCAS_SEQBITS_NEW(0);
+    }
+    memset(stats, 0, sizeof(stats));
 }
 
-template <int MAX_K>
-void KCASLockFree<MAX_K>::helpOther(const int tid, kcastagptr_t tagptr) {
-    kcasdesc_t<MAX_K> newSnapshot;
-    const int sz = kcasdesc_t<MAX_K>::size;
-    //cout<<"size of kcas descriptor is "<<sizeof(kcasdesc_t<MAX_K>)<<" and sz="<<sz<<endl;
-    if (DESC_SNAPSHOT(kcasdesc_t<MAX_K>, kcasDescriptors, &newSnapshot, tagptr, sz)) {
+// the descriptors of kcas operations with up to K entries (K is MAX_K or WIDE_K)
+template <int MAX_K, int MAX_WIDE_K>
+template <int K>
+kcasdesc_t<K> * KCASLockFree<MAX_K, MAX_WIDE_K>::descriptors() {
+    if constexpr (K == MAX_K) {
+        return kcasDescriptors;
+    } else {
+        return wideDescriptors;
+    }
+}
+
+template <int MAX_K, int MAX_WIDE_K>
+void KCASLockFree<MAX_K, MAX_WIDE_K>::helpOther(const int tid, kcastagptr_t tagptr) {
+    if constexpr (MAX_WIDE_K > 0) {
+        if (tagptr & KCAS_WIDE_TAGBIT) {
+            helpOther<WIDE_K>(tid, tagptr);
+            return;
+        }
+    }
+    helpOther<MAX_K>(tid, tagptr);
+}
+
+template <int MAX_K, int MAX_WIDE_K>
+template <int K>
+void KCASLockFree<MAX_K, MAX_WIDE_K>::helpOther(const int tid, kcastagptr_t tagptr) {
+    kcasdesc_t<K> newSnapshot;
+    const int sz = kcasdesc_t<K>::size;
+    //cout<<"size of kcas descriptor is "<<sizeof(kcasdesc_t<K>)<<" and sz="<<sz<<endl;
+    if (DESC_SNAPSHOT(kcasdesc_t<K>, descriptors<K>(), &newSnapshot, tagptr, sz)) {
         help(tid, tagptr, &newSnapshot, true);
     }
 }
 
-template <int MAX_K>
-bool KCASLockFree<MAX_K>::help(const int tid, kcastagptr_t tagptr, kcasptr_t snapshot, bool helpingOther) {
+template <int MAX_K, int MAX_WIDE_K>
+template <int K>
+bool KCASLockFree<MAX_K, MAX_WIDE_K>::help(const int tid, kcastagptr_t tagptr, kcasdesc_t<K> * snapshot, bool helpingOther) {
     // phase 1: "locking" addresses for this kcas
     int newstate;
     
     // read state field
-    kcasptr_t ptr = TAGPTR_UNPACK_PTR(kcasDescriptors, tagptr);
+    kcasdesc_t<K> * ptr = TAGPTR_UNPACK_PTR(descriptors<K>(), tagptr);
     bool successBit;
     int state = DESC_READ_FIELD(successBit, ptr->seqBits, tagptr, KCAS_SEQBITS_MASK_STATE, KCAS_SEQBITS_OFFSET_STATE);
     if (!successBit) {
@@ -318,7 +427,7 @@ bool KCASLockFree<MAX_K>::help(const int tid, kcastagptr_t tagptr, kcasptr_t sna
     }
     
     if (state == KCAS_STATE_UNDECIDED) {
-        newstate = KCAS_STATE_SUCCEEDED;
+        newstate = snapshot->numReadOnly ? KCAS_STATE_READ_CHECK : KCAS_STATE_SUCCEEDED;
         for (int i = helpingOther; i < snapshot->numEntries; i++) {
 retry_entry:
             // prepare rdcss descriptor and run rdcss
@@ -347,10 +456,22 @@ retry_entry:
                 }
             }
         }
+        KCAS_STATS ++stats[tid].cas;
         SEQBITS_CAS_FIELD(successBit
                 , ptr->seqBits, snapshot->seqBits
                 , KCAS_STATE_UNDECIDED, newstate
                 , KCAS_SEQBITS_MASK_STATE, KCAS_SEQBITS_OFFSET_STATE);
+        state = DESC_READ_FIELD(successBit, ptr->seqBits, tagptr, KCAS_SEQBITS_MASK_STATE, KCAS_SEQBITS_OFFSET_STATE);
+        if (!successBit) return false;
+    }
+    // phase 1.5 (only with read-only entries): all other addresses are "locked" for this kcas, so validate the read-only ones
+    if (state == KCAS_STATE_READ_CHECK) {
+        newstate = readCheck(tid, tagptr, snapshot) ? KCAS_STATE_SUCCEEDED : KCAS_STATE_FAILED;
+        KCAS_STATS ++stats[tid].cas;
+        SEQBITS_CAS_FIELD(successBit
+                , ptr->seqBits, snapshot->seqBits
+                , KCAS_STATE_READ_CHECK, newstate
+                , KCAS_SEQBITS_MASK_STATE, KCAS_SEQBITS_OFFSET_STATE);
     }
     // phase 2 (all addresses are now "locked" for this kcas)
     state = DESC_READ_FIELD(successBit, ptr->seqBits, tagptr, KCAS_SEQBITS_MASK_STATE, KCAS_SEQBITS_OFFSET_STATE);
@@ -360,41 +481,133 @@ retry_entry:
 
     for (int i = 0; i < snapshot->numEntries; i++) {
         casword_t newval = succeeded ? snapshot->entries[i].newval : snapshot->entries[i].oldval;
+        KCAS_STATS ++stats[tid].cas;
         BOOL_CAS(snapshot->entries[i].addr, (casword_t) tagptr, newval);
     }
 
     return succeeded;
 }
 
-// TODO: replace crappy bubblesort with something fast for large MAX_K (maybe even use insertion sort for small MAX_K)
+// return true if every read-only entry of the kcas (tagptr, snapshot) still contains its value.
+// the kcas's other entries are locked, and every writer of a read-only word must change or validate one of
+// them (see kcasdesc_t), so the kcas takes effect at its transition to READ_CHECK if this returns true.
+template <int MAX_K, int MAX_WIDE_K>
+template <int K>
+bool KCASLockFree<MAX_K, MAX_WIDE_K>::readCheck(const int tid, kcastagptr_t tagptr, kcasdesc_t<K> * snapshot) {
+    for (int i = K - snapshot->numReadOnly; i < K; i++) {
+        if (readForReadCheck(tid, tagptr, snapshot->entries[i].addr) != snapshot->entries[i].oldval) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// return the logical value of addr for the read check of kcas tagptr, without helping any kcas that is still
+// locking its addresses (its value is the old value until it reaches READ_CHECK, which happens after our read).
+// a kcas that is checking its own reads is helped if it has priority (a smaller tid), and aborted otherwise,
+// so a chain of helping is bounded by the number of threads.
+template <int MAX_K, int MAX_WIDE_K>
+casword_t KCASLockFree<MAX_K, MAX_WIDE_K>::readForReadCheck(const int tid, kcastagptr_t tagptr, casword_t volatile * addr) {
+    while (true) {
+        casword_t val = rdcssRead(tid, addr);
+        if (!isKcas(val)) return val;
+        assert(val != (casword_t) tagptr); // addr must not also be changed by this kcas
+
+        casword_t result;
+        if constexpr (MAX_WIDE_K > 0) {
+            if (val & KCAS_WIDE_TAGBIT) {
+                if (readForReadCheckOther<WIDE_K>(tid, tagptr, addr, val, &result)) return result;
+                continue;
+            }
+        }
+        if (readForReadCheckOther<MAX_K>(tid, tagptr, addr, val, &result)) return result;
+    }
+}
+
+// readForReadCheck for a word that contains the other kcas val (with a descriptor of size K).
+// returns true and sets *result to the logical value of addr, or returns false if addr must be read again.
+template <int MAX_K, int MAX_WIDE_K>
+template <int K>
+bool KCASLockFree<MAX_K, MAX_WIDE_K>::readForReadCheckOther(const int tid, kcastagptr_t tagptr, casword_t volatile * addr, casword_t val, casword_t * result) {
+    kcasdesc_t<K> other;
+    if (!DESC_SNAPSHOT(kcasdesc_t<K>, descriptors<K>(), &other, val, kcasdesc_t<K>::size)) {
+        return false; // the other kcas is finished, so addr no longer contains it
+    }
+    casword_t otherState = SEQBITS_UNPACK_FIELD(other.seqBits, KCAS_SEQBITS_MASK_STATE, KCAS_SEQBITS_OFFSET_STATE);
+    if (otherState == KCAS_STATE_READ_CHECK) {
+        if (TAGPTR_UNPACK_TID(val) < TAGPTR_UNPACK_TID(tagptr)) {
+            help(tid, (kcastagptr_t) val, &other, true);
+        } else {
+            bool successBit;
+            KCAS_STATS ++stats[tid].cas;
+            SEQBITS_CAS_FIELD(successBit
+                    , TAGPTR_UNPACK_PTR(descriptors<K>(), val)->seqBits, other.seqBits
+                    , KCAS_STATE_READ_CHECK, KCAS_STATE_FAILED
+                    , KCAS_SEQBITS_MASK_STATE, KCAS_SEQBITS_OFFSET_STATE);
+        }
+        return false;
+    }
+    for (int i = 0; i < other.numEntries; i++) {
+        if (other.entries[i].addr == addr) {
+            *result = (otherState == KCAS_STATE_SUCCEEDED) ? other.entries[i].newval : other.entries[i].oldval;
+            return true;
+        }
+    }
+    assert(false); // a kcas is only installed in the addresses it changes
+    return false;
+}
+
+// descriptors with at most this many entries are sorted by insertion sort, and larger ones by std::sort
+#ifndef KCAS_INSERTION_SORT_MAX_K
+#define KCAS_INSERTION_SORT_MAX_K 16
+#endif
+
+// sort the changed entries of a kcas descriptor by address (the order in which they are locked).
+// for small MAX_K (all of the data structures in this repo), insertion sort does at most a few compares,
+// which are well predicted since entries are often added in address order. for large MAX_K, std::sort is O(K log K).
 template <int MAX_K>
 static void kcasdesc_sort(kcasptr_t ptr) {
-    kcasentry_t temp;
-    for (int i = 0; i < ptr->numEntries; i++) {
-        for (int j = 0; j < ptr->numEntries - i - 1; j++) {
-            if (ptr->entries[j].addr > ptr->entries[j + 1].addr) {
-                temp = ptr->entries[j];
-                ptr->entries[j] = ptr->entries[j + 1];
-                ptr->entries[j + 1] = temp;
+    const int n = ptr->numEntries;
+    if constexpr (MAX_K <= KCAS_INSERTION_SORT_MAX_K) {
+        for (int i = 1; i < n; i++) {
+            kcasentry_t temp = ptr->entries[i];
+            int j = i - 1;
+            for (; j >= 0 && ptr->entries[j].addr > temp.addr; j--) {
+                ptr->entries[j + 1] = ptr->entries[j];
             }
+            ptr->entries[j + 1] = temp;
         }
+    } else {
+        std::sort(ptr->entries, ptr->entries + n, [](const kcasentry_t & a, const kcasentry_t & b) {
+            return a.addr < b.addr;
+        });
     }
 }
 
-template <int MAX_K>
-bool KCASLockFree<MAX_K>::execute(const int tid, kcasptr_t ptr) {
-    // sort entries in the kcas descriptor to guarantee progress
-    kcasdesc_sort<MAX_K>(ptr);
-    DESC_INITIALIZED(kcasDescriptors, tid);
-    kcastagptr_t tagptr = TAGPTR_NEW(tid, ptr->seqBits, KCAS_TAGBIT);
+// ptr must be the descriptor returned by getDescriptor(tid) or getWideDescriptor(tid)
+template <int MAX_K, int MAX_WIDE_K>
+template <int K>
+bool KCASLockFree<MAX_K, MAX_WIDE_K>::execute(const int tid, kcasdesc_t<K> * ptr) {
+    static_assert(K == MAX_K || (MAX_WIDE_K > 0 && K == WIDE_K), "not a descriptor of this kcas");
+    assert(ptr == &descriptors<K>()[tid]);
+    if (kcasLockReadOnlyEntries) {
+        while (ptr->numReadOnly) {
+            ptr->entries[ptr->numEntries++] = ptr->entries[K - ptr->numReadOnly--];
+        }
+    }
+    KCAS_STATS ++stats[tid].executions;
+    // sort entries in the kcas descriptor to guarantee progress (read-only entries are not locked, so need no order)
+    kcasdesc_sort<K>(ptr);
+    DESC_INITIALIZED(descriptors<K>(), tid);
+    kcastagptr_t tagptr = TAGPTR_NEW(tid, ptr->seqBits, (K == MAX_K) ? KCAS_TAGBIT : (KCAS_TAGBIT | KCAS_WIDE_TAGBIT));
 
     // perform the kcas and retire the old descriptor
     bool result = help(tid, tagptr, ptr, false);
     return result;
 }
 
-template <int MAX_K>
-casword_t KCASLockFree<MAX_K>::readPtr(const int tid, casword_t volatile * addr) {
+template <int MAX_K, int MAX_WIDE_K>
+casword_t KCASLockFree<MAX_K, MAX_WIDE_K>::readPtr(const int tid, casword_t volatile * addr) {
     casword_t r;
     do {
         r = rdcssRead(tid, addr);
@@ -405,25 +618,48 @@ casword_t KCASLockFree<MAX_K>::readPtr(const int tid, casword_t volatile * addr)
     return r;
 }
 
-template <int MAX_K>
-casword_t KCASLockFree<MAX_K>::readVal(const int tid, casword_t volatile * addr) {
+template <int MAX_K, int MAX_WIDE_K>
+casword_t KCASLockFree<MAX_K, MAX_WIDE_K>::readVal(const int tid, casword_t volatile * addr) {
     return ((casword_t) readPtr(tid, addr))>>KCAS_LEFTSHIFT;
 }
 
-template <int MAX_K>
-void KCASLockFree<MAX_K>::writeInitPtr(const int tid, casword_t volatile * addr, casword_t const newval) {
+template <int MAX_K, int MAX_WIDE_K>
+void KCASLockFree<MAX_K, MAX_WIDE_K>::writeInitPtr(const int tid, casword_t volatile * addr, casword_t const newval) {
     *addr = newval;
 }
 
-template <int MAX_K>
-void KCASLockFree<MAX_K>::writeInitVal(const int tid, casword_t volatile * addr, casword_t const newval) {
+template <int MAX_K, int MAX_WIDE_K>
+void KCASLockFree<MAX_K, MAX_WIDE_K>::writeInitVal(const int tid, casword_t volatile * addr, casword_t const newval) {
     writeInitPtr(tid, addr, newval<<KCAS_LEFTSHIFT);
 }
 
-template <int MAX_K>
-kcasptr_t KCASLockFree<MAX_K>::getDescriptor(const int tid) {
+template <int MAX_K, int MAX_WIDE_K>
+kcasptr_t KCASLockFree<MAX_K, MAX_WIDE_K>::getDescriptor(const int tid) {
     // allocate a new kcas descriptor
     kcasptr_t ptr = DESC_NEW(kcasDescriptors, KCAS_SEQBITS_NEW, tid);
     ptr->numEntries = 0;
+    ptr->numReadOnly = 0;
     return ptr;
 }
+
+// a descriptor for a kcas with up to MAX_WIDE_K entries (only for tid < KCAS_WIDE_TIDS)
+template <int MAX_K, int MAX_WIDE_K>
+kcasdesc_t<KCASLockFree<MAX_K, MAX_WIDE_K>::WIDE_K> * KCASLockFree<MAX_K, MAX_WIDE_K>::getWideDescriptor(const int tid) {
+    static_assert(MAX_WIDE_K > 0, "this kcas has no wide descriptors");
+    assert(tid < KCAS_WIDE_TIDS);
+    kcasdesc_t<WIDE_K> * ptr = DESC_NEW(wideDescriptors, KCAS_SEQBITS_NEW, tid);
+    ptr->numEntries = 0;
+    ptr->numReadOnly = 0;
+    return ptr;
+}
+
+// print the number of kcas operations executed, and of CAS instructions they (and their helpers) performed
+template <int MAX_K, int MAX_WIDE_K>
+void KCASLockFree<MAX_K, MAX_WIDE_K>::printStats() {
+    long long executions = 0, cas = 0;
+    for (int tid = 0; tid <= LAST_TID; ++tid) {
+        executions += stats[tid].executions;
+        cas += stats[tid].cas;
+    }
+    KCAS_STATS cout<<"kcas_executions="<<executions<<" kcas_cas="<<cas<<" cas_per_kcas="<<(executions ? (double) cas / executions : 0)<<endl;
+}
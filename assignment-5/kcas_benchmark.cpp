@@ -0,0 +1,97 @@
+/**
+ * A single threaded micro-benchmark for KCASLockFree::execute.
+ * It reports the average latency of a kcas on k words (each in its own cache line) when its entries are added
+ * in address order (sorted), in reverse address order (reverse), or in a random order (unsorted),
+ * which shows the cost of sorting the entries of the descriptor (kcasdesc_sort) in each case.
+ * k up to 6 uses KCASLockFree<6> (like the list and trees); larger k use larger MAX_K, which sort with std::sort.
+ */
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <chrono>
+
+#include "defines.h"
+#include "kcas.h"
+
+using namespace std;
+
+enum entry_order_t { ORDER_SORTED, ORDER_REVERSE, ORDER_UNSORTED };
+const char * orderNames[] = { "sorted", "reverse", "unsorted" };
+
+#define NUM_PERMUTATIONS 64
+
+struct paddedword_t {
+    casword_t word;
+    volatile char padding[PADDING_BYTES-sizeof(casword_t)];
+};
+
+// NUM_PERMUTATIONS orders in which the entries of a kcas on words[0..k) are added
+vector<vector<int>> makeOrders(entry_order_t order, int k) {
+    vector<vector<int>> orders(NUM_PERMUTATIONS, vector<int>(k));
+    mt19937 rng(12345);
+    for (auto & perm : orders) {
+        for (int i=0;i<k;++i) {
+            perm[i] = (order == ORDER_REVERSE) ? k-1-i : i;
+        }
+        if (order == ORDER_UNSORTED) shuffle(perm.begin(), perm.end(), rng);
+    }
+    return orders;
+}
+
+template <int MAX_K>
+void runK(int k, int iterations) {
+    auto kcas = new KCASLockFree<MAX_K>();
+    auto words = new paddedword_t[k];
+    for (int i=0;i<k;++i) kcas->writeInitVal(0, &words[i].word, 0);
+
+    casword_t val = 0;
+    for (int order=ORDER_SORTED;order<=ORDER_UNSORTED;++order) {
+        auto orders = makeOrders((entry_order_t) order, k);
+        auto start = chrono::high_resolution_clock::now();
+        for (int it=0;it<iterations;++it) {
+            auto & perm = orders[it % NUM_PERMUTATIONS];
+            auto descPtr = kcas->getDescriptor(0);
+            for (int i=0;i<k;++i) {
+                descPtr->addValAddr(&words[perm[i]].word, val, val+1);
+            }
+            if (!kcas->execute(0, descPtr)) {
+                cout<<"ERROR: uncontended kcas failed"<<endl;
+                exit(1);
+            }
+            ++val;
+        }
+        auto nanos = chrono::duration_cast<chrono::nanoseconds>(chrono::high_resolution_clock::now() - start).count();
+        cout<<"max_k="<<MAX_K<<" k="<<k<<" order="<<orderNames[order]<<" ns_per_kcas="<<(double) nanos / iterations<<endl;
+    }
+
+    delete[] words;
+    delete kcas;
+}
+
+int main(int argc, char** argv) {
+    int iterations = 1000000;
+
+    for (int i=1;i<argc;++i) {
+        if (strcmp(argv[i], "-n") == 0) {
+            iterations = atoi(argv[++i]);
+        } else {
+            cout<<"USAGE: "<<argv[0]<<" [options]"<<endl;
+            cout<<"Options:"<<endl;
+            cout<<"    -n [int]     number of kcas operations for each k and entry order (default 1000000)"<<endl;
+            return 1;
+        }
+    }
+    PRINT(iterations);
+    PRINT(KCAS_INSERTION_SORT_MAX_K);
+    cout<<endl;
+
+    for (int k=1;k<=6;++k) runK<6>(k, iterations);
+    runK<16>(16, iterations);
+    runK<64>(32, iterations / 4);
+    runK<64>(64, iterations / 8);
+    return 0;
+}
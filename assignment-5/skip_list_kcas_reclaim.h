@@ -0,0 +1,240 @@
+#pragma once
+
+#include <cassert>
+#include "recordmgr/record_manager.h"
+#include "util.h"
+#include "kcas.h"
+
+/**
+ * lock-free skip list built on KCASLockFree, with memory reclamation (like DoublyLinkedListReclaim).
+ *
+ * every update changes all levels of a node's tower with ONE kcas: an insert links the new node into
+ * levels [0, height) at once, and an erase marks the node and unlinks it from all of its levels at once.
+ * so a node is always either in all of its levels or in none of them, and there are no partially linked towers
+ * for other threads to finish. the kcas also validates (as read-only entries) that each predecessor is unmarked,
+ * and, for an erase, that the erased node's next pointers are unchanged. these pointers can change and change
+ * back (node->next[i] goes A -> B -> A when B is inserted after node and then erased), but every change to
+ * node->next[i] must validate node->mark, which the erase of node locks. so once the erase reaches its read
+ * check, no such change can take effect until the erase is decided (see kcasdesc_t in kcas.h).
+ *
+ * a search can pass through nodes that were erased after it read a pointer to them (they stay safe to read
+ * thanks to the record manager), which is caught by the kcas of the update.
+ */
+
+#ifndef SKIPLIST_MAX_LEVEL
+#define SKIPLIST_MAX_LEVEL 12   // with SKIPLIST_MAX_LEVEL levels of probability 1/4, enough for 4^12 = 16M keys
+#endif
+#define SKIPLIST_MAX_K (3*SKIPLIST_MAX_LEVEL+1) // largest kcas: an erase of a node of height SKIPLIST_MAX_LEVEL
+
+struct SkipNode {
+    casword_t next[SKIPLIST_MAX_LEVEL];
+    casword_t mark;
+    int val;
+    int height;
+};
+
+class SkipListReclaim {
+private:
+    volatile char padding0[PADDING_BYTES];
+    const int numThreads;
+    const int minKey;
+    const int maxKey;
+    volatile char padding1[PADDING_BYTES];
+
+    SkipNode * head;
+    SkipNode * tail;
+    KCASLockFree<SKIPLIST_MAX_K> kcas;
+    simple_record_manager<SkipNode> * recmgr;
+    PaddedRandom rngs[MAX_THREADS];
+
+    void initNode(const int tid, SkipNode * node, int val, int height, SkipNode * const * succs);
+    int randomHeight(const int tid);
+    void internalSearch(const int tid, const int & key, SkipNode ** preds, SkipNode ** succs);
+    void addPredMarks(kcasdesc_t<SKIPLIST_MAX_K> * descPtr, SkipNode * const * preds, int height);
+
+public:
+    SkipListReclaim(const int _numThreads, const int _minKey, const int _maxKey);
+    ~SkipListReclaim();
+    bool contains(const int tid, const int & key);
+    bool insertIfAbsent(const int tid, const int & key); // try to insert key; return true if successful (if it doesn't already exist), false otherwise
+    bool erase(const int tid, const int & key); // try to erase key; return true if successful, false otherwise
+
+    long getSumOfKeys(); // should return the sum of all keys in the set
+    void printDebuggingDetails(); // print any debugging details you want at the end of a trial in this function
+};
+
+SkipListReclaim::SkipListReclaim(const int _numThreads, const int _minKey, const int _maxKey)
+        : numThreads(_numThreads), minKey(_minKey), maxKey(_maxKey) {
+    recmgr = new simple_record_manager<SkipNode>(MAX_THREADS);
+    auto guard = recmgr->getGuard(0);
+    for (int tid = 0; tid < MAX_THREADS; ++tid) rngs[tid].setSeed(tid + 1); // xorshift needs a nonzero seed
+
+    SkipNode * nulls[SKIPLIST_MAX_LEVEL] = {};
+    tail = recmgr->allocate<SkipNode>(0);
+    initNode(0, tail, _maxKey + 1, SKIPLIST_MAX_LEVEL, nulls);
+
+    SkipNode * tails[SKIPLIST_MAX_LEVEL];
+    for (int i = 0; i < SKIPLIST_MAX_LEVEL; ++i) tails[i] = tail;
+    head = recmgr->allocate<SkipNode>(0);
+    initNode(0, head, _minKey - 1, SKIPLIST_MAX_LEVEL, tails);
+}
+
+SkipListReclaim::~SkipListReclaim() {
+    SkipNode * curr = head;
+    while (curr != NULL) {
+        SkipNode * next = (SkipNode *) kcas.readPtr(0, &curr->next[0]);
+        recmgr->deallocate(0, curr);
+        curr = next;
+    }
+    delete recmgr;
+}
+
+// node->next[i] = succs[i] for the levels of the node, and NULL above them
+void SkipListReclaim::initNode(const int tid, SkipNode * node, int val, int height, SkipNode * const * succs) {
+    for (int i = 0; i < SKIPLIST_MAX_LEVEL; ++i) {
+        kcas.writeInitPtr(tid, &node->next[i], (casword_t) (i < height ? succs[i] : NULL));
+    }
+    node->val = val;
+    node->height = height;
+    kcas.writeInitVal(tid, &node->mark, (casword_t) false);
+}
+
+// a node has height h with probability (3/4)(1/4)^(h-1), up to SKIPLIST_MAX_LEVEL
+int SkipListReclaim::randomHeight(const int tid) {
+    unsigned int r = rngs[tid].nextNatural();
+    int height = 1 + __builtin_ctz(r | (1u << 31)) / 2;
+    return min(height, SKIPLIST_MAX_LEVEL);
+}
+
+// for every level i, find preds[i] and succs[i] such that preds[i]->val < key <= succs[i]->val
+// and preds[i]->next[i] was succs[i] when it was read
+void SkipListReclaim::internalSearch(const int tid, const int & key, SkipNode ** preds, SkipNode ** succs) {
+    SkipNode * pred = head;
+    for (int level = SKIPLIST_MAX_LEVEL - 1; level >= 0; --level) {
+        SkipNode * curr = (SkipNode *) kcas.readPtr(tid, &pred->next[level]);
+        while (curr->val < key) {
+            pred = curr;
+            curr = (SkipNode *) kcas.readPtr(tid, &curr->next[level]);
+        }
+        preds[level] = pred;
+        succs[level] = curr;
+    }
+}
+
+// validate that the predecessors at levels [0, height) are unmarked.
+// the same node is often the predecessor at consecutive levels, and its mark is only added once.
+void SkipListReclaim::addPredMarks(kcasdesc_t<SKIPLIST_MAX_K> * descPtr, SkipNode * const * preds, int height) {
+    for (int i = 0; i < height; ++i) {
+        if (i == 0 || preds[i] != preds[i - 1]) {
+            descPtr->addValAddrReadOnly(&preds[i]->mark, (casword_t) false);
+        }
+    }
+}
+
+bool SkipListReclaim::contains(const int tid, const int & key) {
+    assert(key > minKey - 1 && key >= minKey && key <= maxKey && key < maxKey + 1);
+    auto guard = recmgr->getGuard(tid);
+    SkipNode * pred = head;
+    for (int level = SKIPLIST_MAX_LEVEL - 1; level >= 0; --level) {
+        SkipNode * curr = (SkipNode *) kcas.readPtr(tid, &pred->next[level]);
+        while (curr->val < key) {
+            pred = curr;
+            curr = (SkipNode *) kcas.readPtr(tid, &curr->next[level]);
+        }
+        if (curr->val == key) {
+            return !kcas.readVal(tid, &curr->mark); // a node is marked exactly when it is unlinked from all levels
+        }
+    }
+    return false;
+}
+
+bool SkipListReclaim::insertIfAbsent(const int tid, const int & key) {
+    assert(key > minKey - 1 && key >= minKey && key <= maxKey && key < maxKey + 1);
+    auto guard = recmgr->getGuard(tid);
+    SkipNode * preds[SKIPLIST_MAX_LEVEL];
+    SkipNode * succs[SKIPLIST_MAX_LEVEL];
+    while (true) {
+        internalSearch(tid, key, preds, succs);
+        if (succs[0]->val == key) {
+            if (!kcas.readVal(tid, &succs[0]->mark)) return false;
+            continue; // we passed through an erased node, so search again
+        }
+        const int height = randomHeight(tid);
+        SkipNode * n = recmgr->allocate<SkipNode>(tid);
+        initNode(tid, n, key, height, succs);
+
+        auto descPtr = kcas.getDescriptor(tid);
+        addPredMarks(descPtr, preds, height);
+        for (int i = 0; i < height; ++i) {
+            descPtr->addPtrAddr(&preds[i]->next[i], (casword_t) succs[i], (casword_t) n);
+        }
+
+        if (kcas.execute(tid, descPtr)) {
+            return true;
+        } else {
+            recmgr->deallocate(tid, n);
+        }
+    }
+    assert(false);
+}
+
+bool SkipListReclaim::erase(const int tid, const int & key) {
+    assert(key > minKey - 1 && key >= minKey && key <= maxKey && key < maxKey + 1);
+    auto guard = recmgr->getGuard(tid);
+    SkipNode * preds[SKIPLIST_MAX_LEVEL];
+    SkipNode * succs[SKIPLIST_MAX_LEVEL];
+    while (true) {
+        internalSearch(tid, key, preds, succs);
+        SkipNode * n = succs[0];
+        if (n->val != key) {
+            return false;
+        }
+        const int height = n->height;
+        bool found = true;
+        for (int i = 0; i < height; ++i) {
+            if (succs[i] != n) found = false; // we passed through an erased node at level i
+        }
+        if (!found) continue;
+
+        auto descPtr = kcas.getDescriptor(tid);
+        addPredMarks(descPtr, preds, height);
+        descPtr->addValAddr(&n->mark, (casword_t) false, (casword_t) true);
+        for (int i = 0; i < height; ++i) {
+            casword_t after = kcas.readPtr(tid, &n->next[i]);
+            descPtr->addPtrAddrReadOnly(&n->next[i], after);
+            descPtr->addPtrAddr(&preds[i]->next[i], (casword_t) n, after);
+        }
+
+        if (kcas.execute(tid, descPtr)) {
+            recmgr->retire(tid, n);
+            return true;
+        }
+    }
+    assert(false);
+}
+
+long SkipListReclaim::getSumOfKeys() {
+    auto guard = recmgr->getGuard(0);
+    SkipNode * temp = (SkipNode *) kcas.readPtr(0, &head->next[0]);
+    long total = 0;
+    while (temp != tail) {
+        total += temp->val;
+        temp = (SkipNode *) kcas.readPtr(0, &temp->next[0]);
+    }
+    return total;
+}
+
+void SkipListReclaim::printDebuggingDetails() {
+    // number of nodes with each height
+    auto guard = recmgr->getGuard(0);
+    long long heights[SKIPLIST_MAX_LEVEL+1] = {};
+    SkipNode * temp = (SkipNode *) kcas.readPtr(0, &head->next[0]);
+    while (temp != tail) {
+        ++heights[temp->height];
+        temp = (SkipNode *) kcas.readPtr(0, &temp->next[0]);
+    }
+    cout<<"heights:";
+    for (int h = 1; h <= SKIPLIST_MAX_LEVEL; ++h) cout<<" "<<h<<"="<<heights[h];
+    cout<<endl;
+    kcas.printStats();
+}
@@ -70,3 +70,17 @@ void casword<T>::addToDescriptor(T oldVal, T newVal){
 	descriptor->addValAddr(&bits, c_oldVal, c_newVal);
     }
 }
+
+template <typename T>
+void casword<T>::addReadOnlyToDescriptor(T val){
+    auto descriptor = kcas::instance.getDescriptor();
+    auto c_val = (casword_t)val;
+    assert((c_val & 0xE000000000000000) == 0);
+
+    if(is_pointer<T>::value){
+	descriptor->addPtrAddrReadOnly(&bits, c_val);
+    }
+    else {
+	descriptor->addValAddrReadOnly(&bits, c_val);
+    }
+}
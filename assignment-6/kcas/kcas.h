@@ -19,6 +19,8 @@ public:
     T getValue();
 
     void addToDescriptor(T oldVal, T newVal);
+
+    void addReadOnlyToDescriptor(T val);
 };
 
 #include "kcas_reuse_impl.h"
@@ -64,6 +66,21 @@ namespace kcas {
         instance.add(caswordptr, oldVal, newVal, args...);
     }
 
+    // add words that are only validated (not changed) by the kcas (see kcasdesc_t)
+    template<typename T>
+    void addReadOnly(casword<T> * caswordptr, T val) {
+        return instance.addReadOnly(caswordptr, val);
+    }
+
+    template<typename T, typename... Args>
+    void addReadOnly(casword<T> * caswordptr, T val, Args... args) {
+        instance.addReadOnly(caswordptr, val, args...);
+    }
+
+    void printStats() {
+        return instance.printStats();
+    }
+
 };
 
 #include "casword.h"
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include <stdint.h>
 #include <sstream>
 #include <cstring>
+#include <algorithm>
 #include <immintrin.h>
 
 using namespace std;
@@ -148,6 +149,24 @@ typedef intptr_t seqbits_t;
 #define KCAS_STATE_UNDECIDED 0
 #define KCAS_STATE_SUCCEEDED 4
 #define KCAS_STATE_FAILED 8
+#define KCAS_STATE_READ_CHECK 12
+#define KCAS_STATE_OPTIMISTIC 1
+
+// compile with -DKCAS_STATS=if\(1\) to count the CAS instructions performed by KCAS operations (see printStats)
+#ifndef KCAS_STATS
+#define KCAS_STATS if(0)
+#endif
+
+// if true, read-only entries are locked and written back like other entries (for comparison with read-only validation)
+bool kcasLockReadOnlyEntries = false;
+
+// if true, a kcas that changes one word (and has no read-only entries) is performed with a single CAS
+bool kcasSingleWordCAS = true;
+
+// if true, a kcas first tries to install its descriptor in all of its words with plain CAS (without RDCSS),
+// in the OPTIMISTIC state, which only its owner can move forward (a helper that finds it aborts it instead).
+// if that attempt is aborted, or finds another kcas in one of its words, the kcas is retried with the normal protocol.
+bool kcasOptimistic = false;
 
 #define KCAS_LEFTSHIFT 2
 
@@ -214,13 +233,32 @@ struct kcasentry_t { // just part of kcasdesc_t, not a standalone descriptor
 };
 
 
+/**
+ * a kcas descriptor has numEntries entries that are changed (entries[0 .. numEntries)),
+ * and numReadOnly read-only entries, which are stored from the end of entries (entries[MAX_K-numReadOnly .. MAX_K)).
+ *
+ * a read-only entry (with oldval == newval) is never locked: it is validated by reading it once every other
+ * entry is locked, in the READ_CHECK state (as in Fraser's OSTM). an address must not be both a read-only
+ * entry and a changed entry of the same kcas.
+ * read-only words CAN change and change back while a kcas reads them (e.g., in the external tree, a child pointer
+ * goes n -> n1 -> n when an insert places leaf n under a new internal node n1 and the new leaf is then erased).
+ * the invariant that read-only entries rely on instead: every kcas that changes a word that some kcas reads as a
+ * read-only entry also changes or validates a word that the reading kcas locks. (the tree's erase reads the child
+ * pointers of the parent and locks the parent's mark, and every kcas that changes a child pointer of a node
+ * validates or changes that node's mark.) so a writer of a read-only word conflicts with the reading kcas while
+ * it holds its locks, and the word cannot change between the reading kcas's transition to READ_CHECK and its
+ * read check.
+ * a kcas with read-only entries can fail spuriously if it conflicts with another kcas that is validating its
+ * read-only entries (as a weak CAS can), so it should be retried by the caller.
+ */
 template <int MAX_K>
 class kcasdesc_t {
 public:
     volatile seqbits_t seqBits;
     casword_t numEntries;
+    casword_t numReadOnly;
     kcasentry_t entries[MAX_K];
-    const static int size = sizeof(seqBits)+sizeof(numEntries)+sizeof(entries);
+    const static int size = sizeof(seqBits)+sizeof(numEntries)+sizeof(numReadOnly)+sizeof(entries);
     volatile char padding[128+((64-size%64)%64)]; // add padding to prevent false sharing
 
     void addValAddr(casword_t volatile * addr, casword_t oldval, casword_t newval) {
@@ -228,7 +266,7 @@ public:
         entries[numEntries].oldval = oldval << KCAS_LEFTSHIFT;
         entries[numEntries].newval = newval << KCAS_LEFTSHIFT;
         ++numEntries;
-        assert(numEntries <= MAX_K);
+        assert(numEntries + numReadOnly <= MAX_K);
     }
 
     void addPtrAddr(casword_t volatile * addr, casword_t oldval, casword_t newval) {
@@ -236,7 +274,19 @@ public:
         entries[numEntries].oldval = oldval;
         entries[numEntries].newval = newval;
         ++numEntries;
-        assert(numEntries <= MAX_K);
+        assert(numEntries + numReadOnly <= MAX_K);
+    }
+
+    void addValAddrReadOnly(casword_t volatile * addr, casword_t val) {
+        addPtrAddrReadOnly(addr, val << KCAS_LEFTSHIFT);
+    }
+
+    void addPtrAddrReadOnly(casword_t volatile * addr, casword_t val) {
+        ++numReadOnly;
+        assert(numEntries + numReadOnly <= MAX_K);
+        entries[MAX_K - numReadOnly].addr = addr;
+        entries[MAX_K - numReadOnly].oldval = val;
+        entries[MAX_K - numReadOnly].newval = val;
     }
 };
 
@@ -271,6 +321,13 @@ private:
     rdcssdesc_t rdcssDescriptors[LAST_TID+1] __attribute__ ((aligned(64)));
     volatile char __padding_desc3[128];
 
+    struct kcasstats_t {
+        long long executions;
+        long long cas;          // CAS instructions on data words and descriptors
+        volatile char padding[64-2*sizeof(long long)];
+    };
+    kcasstats_t stats[KCAS_MAX_THREADS] __attribute__ ((aligned(64)));
+
     /**
      * Function declarations
      */
@@ -291,9 +348,18 @@ public:
     void add(casword<T> * caswordptr, T oldVal, T newVal);
     template<typename T, typename... Args>
     void add(casword<T> * caswordptr, T oldVal, T newVal, Args... args);
+    template<typename T>
+    void addReadOnly(casword<T> * caswordptr, T val);
+    template<typename T, typename... Args>
+    void addReadOnly(casword<T> * caswordptr, T val, Args... args);
+    void printStats();
 private:
     casword_t rdcss(rdcssptr_t ptr, rdcsstagptr_t tagptr);
     bool help(kcastagptr_t tagptr, kcasptr_t ptr, bool helpingOther);
+    bool readCheck(kcastagptr_t tagptr, kcasptr_t snapshot);
+    bool casSingleWord(kcasentry_t * entry);
+    int executeOptimistic(kcasptr_t desc);
+    casword_t readForReadCheck(kcastagptr_t tagptr, casword_t volatile * addr);
     void rdcssHelp(rdcsstagptr_t tagptr, rdcssptr_t snapshot, bool helpingOther);
     void rdcssHelpOther(rdcsstagptr_t tagptr);
 };
@@ -326,12 +392,16 @@ template <int MAX_K>
 casword_t KCASLockFree<MAX_K>::rdcss(rdcssptr_t ptr, rdcsstagptr_t tagptr) {
     casword_t r;
     do {
+        KCAS_STATS ++stats[kcas_tid.getId()].cas;
         r = VAL_CAS(ptr->addr2, ptr->old2, (casword_t) tagptr);
         if (isRdcss(r)) {
             rdcssHelpOther((rdcsstagptr_t) r);
         }
     } while (isRdcss(r));
-    if (r == ptr->old2) rdcssHelp(tagptr, ptr, false); // finish our own operation
+    if (r == ptr->old2) {
+        KCAS_STATS ++stats[kcas_tid.getId()].cas;
+        rdcssHelp(tagptr, ptr, false); // finish our own operation
+    }
     return r;
 }
 
@@ -351,6 +421,7 @@ template <int MAX_K>
 KCASLockFree<MAX_K>::KCASLockFree() {
     DESC_INIT_ALL(kcasDescriptors, KCAS_SEQBITS_NEW);
     DESC_INIT_ALL(rdcssDescriptors, RDCSS_SEQBITS_NEW);
+    memset(stats, 0, sizeof(stats));
 }
 
 template <int MAX_K>
@@ -377,8 +448,20 @@ bool KCASLockFree<MAX_K>::help(kcastagptr_t tagptr, kcasptr_t snapshot, bool hel
         return false;
     }
 
+    if (state == KCAS_STATE_OPTIMISTIC) {
+        // only the owner of an optimistic kcas installs it in its words, so a helper aborts it
+        // (its owner then retries it with the normal protocol)
+        KCAS_STATS ++stats[kcas_tid.getId()].cas;
+        SEQBITS_CAS_FIELD(successBit
+        , ptr->seqBits, snapshot->seqBits
+        , KCAS_STATE_OPTIMISTIC, KCAS_STATE_FAILED
+        , KCAS_SEQBITS_MASK_STATE, KCAS_SEQBITS_OFFSET_STATE);
+        state = DESC_READ_FIELD(successBit, ptr->seqBits, tagptr, KCAS_SEQBITS_MASK_STATE, KCAS_SEQBITS_OFFSET_STATE);
+        if (!successBit) return false;
+    }
+
     if (state == KCAS_STATE_UNDECIDED) {
-        newstate = KCAS_STATE_SUCCEEDED;
+        newstate = snapshot->numReadOnly ? KCAS_STATE_READ_CHECK : KCAS_STATE_SUCCEEDED;
         for (int i = helpingOther; i < snapshot->numEntries; i++) {
             retry_entry:
             // prepare rdcss descriptor and run rdcss
@@ -407,10 +490,22 @@ bool KCASLockFree<MAX_K>::help(kcastagptr_t tagptr, kcasptr_t snapshot, bool hel
                 }
             }
         }
+        KCAS_STATS ++stats[kcas_tid.getId()].cas;
         SEQBITS_CAS_FIELD(successBit
         , ptr->seqBits, snapshot->seqBits
         , KCAS_STATE_UNDECIDED, newstate
         , KCAS_SEQBITS_MASK_STATE, KCAS_SEQBITS_OFFSET_STATE);
+        state = DESC_READ_FIELD(successBit, ptr->seqBits, tagptr, KCAS_SEQBITS_MASK_STATE, KCAS_SEQBITS_OFFSET_STATE);
+        if (!successBit) return false;
+    }
+    // phase 1.5 (only with read-only entries): all other addresses are "locked" for this kcas, so validate the read-only ones
+    if (state == KCAS_STATE_READ_CHECK) {
+        newstate = readCheck(tagptr, snapshot) ? KCAS_STATE_SUCCEEDED : KCAS_STATE_FAILED;
+        KCAS_STATS ++stats[kcas_tid.getId()].cas;
+        SEQBITS_CAS_FIELD(successBit
+        , ptr->seqBits, snapshot->seqBits
+        , KCAS_STATE_READ_CHECK, newstate
+        , KCAS_SEQBITS_MASK_STATE, KCAS_SEQBITS_OFFSET_STATE);
     }
     // phase 2 (all addresses are now "locked" for this kcas)
     state = DESC_READ_FIELD(successBit, ptr->seqBits, tagptr, KCAS_SEQBITS_MASK_STATE, KCAS_SEQBITS_OFFSET_STATE);
@@ -420,33 +515,161 @@ bool KCASLockFree<MAX_K>::help(kcastagptr_t tagptr, kcasptr_t snapshot, bool hel
 
     for (int i = 0; i < snapshot->numEntries; i++) {
         casword_t newval = succeeded ? snapshot->entries[i].newval : snapshot->entries[i].oldval;
+        KCAS_STATS ++stats[kcas_tid.getId()].cas;
         BOOL_CAS(snapshot->entries[i].addr, (casword_t) tagptr, newval);
     }
 
     return succeeded;
 }
 
-// TODO: replace crappy bubblesort with something fast for large MAX_K (maybe even use insertion sort for small MAX_K)
+// return true if every read-only entry of the kcas (tagptr, snapshot) still contains its value.
+// the kcas's other entries are locked, and every writer of a read-only word must change or validate one of
+// them (see kcasdesc_t), so the kcas takes effect at its transition to READ_CHECK if this returns true.
+template <int MAX_K>
+bool KCASLockFree<MAX_K>::readCheck(kcastagptr_t tagptr, kcasptr_t snapshot) {
+    for (int i = MAX_K - snapshot->numReadOnly; i < MAX_K; i++) {
+        if (readForReadCheck(tagptr, snapshot->entries[i].addr) != snapshot->entries[i].oldval) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// return the logical value of addr for the read check of kcas tagptr, without helping any kcas that is still
+// locking its addresses (its value is the old value until it reaches READ_CHECK, which happens after our read).
+// a kcas that is checking its own reads is helped if it has priority (a smaller tid), and aborted otherwise,
+// so a chain of helping is bounded by the number of threads.
+template <int MAX_K>
+casword_t KCASLockFree<MAX_K>::readForReadCheck(kcastagptr_t tagptr, casword_t volatile * addr) {
+    while (true) {
+        casword_t val = rdcssRead(addr);
+        if (!isKcas(val)) return val;
+        assert(val != (casword_t) tagptr); // addr must not also be changed by this kcas
+
+        kcasdesc_t<MAX_K> other;
+        if (!DESC_SNAPSHOT(kcasdesc_t<MAX_K>, kcasDescriptors, &other, val, kcasdesc_t<MAX_K>::size)) {
+            continue; // the other kcas is finished, so addr no longer contains it
+        }
+        casword_t otherState = SEQBITS_UNPACK_FIELD(other.seqBits, KCAS_SEQBITS_MASK_STATE, KCAS_SEQBITS_OFFSET_STATE);
+        if (otherState == KCAS_STATE_READ_CHECK) {
+            if (TAGPTR_UNPACK_TID(val) < TAGPTR_UNPACK_TID(tagptr)) {
+                help((kcastagptr_t) val, &other, true);
+            } else {
+                bool successBit;
+                KCAS_STATS ++stats[kcas_tid.getId()].cas;
+                SEQBITS_CAS_FIELD(successBit
+                , TAGPTR_UNPACK_PTR(kcasDescriptors, val)->seqBits, other.seqBits
+                , KCAS_STATE_READ_CHECK, KCAS_STATE_FAILED
+                , KCAS_SEQBITS_MASK_STATE, KCAS_SEQBITS_OFFSET_STATE);
+            }
+            continue;
+        }
+        for (int i = 0; i < other.numEntries; i++) {
+            if (other.entries[i].addr == addr) {
+                return (otherState == KCAS_STATE_SUCCEEDED) ? other.entries[i].newval : other.entries[i].oldval;
+            }
+        }
+        assert(false); // a kcas is only installed in the addresses it changes
+    }
+}
+
+#ifndef KCAS_INSERTION_SORT_MAX_K
+#define KCAS_INSERTION_SORT_MAX_K 16
+#endif
+
+// sort the changed entries of a kcas descriptor by address (the order in which they are locked).
+// for small MAX_K (the trees use 6), insertion sort does at most a few compares,
+// which are well predicted since entries are often added in address order. for large MAX_K, std::sort is O(K log K).
 template <int MAX_K>
 static void kcasdesc_sort(kcasptr_t ptr) {
-    kcasentry_t temp;
-    for (int i = 0; i < ptr->numEntries; i++) {
-        for (int j = 0; j < ptr->numEntries - i - 1; j++) {
-            if (ptr->entries[j].addr > ptr->entries[j + 1].addr) {
-                temp = ptr->entries[j];
-                ptr->entries[j] = ptr->entries[j + 1];
-                ptr->entries[j + 1] = temp;
+    const int n = ptr->numEntries;
+    if constexpr (MAX_K <= KCAS_INSERTION_SORT_MAX_K) {
+        for (int i = 1; i < n; i++) {
+            kcasentry_t temp = ptr->entries[i];
+            int j = i - 1;
+            for (; j >= 0 && ptr->entries[j].addr > temp.addr; j--) {
+                ptr->entries[j + 1] = ptr->entries[j];
             }
+            ptr->entries[j + 1] = temp;
+        }
+    } else {
+        std::sort(ptr->entries, ptr->entries + n, [](const kcasentry_t & a, const kcasentry_t & b) {
+            return a.addr < b.addr;
+        });
+    }
+}
+
+// a kcas that changes one word is linearizable as a plain CAS, as long as it helps any descriptor it finds
+template <int MAX_K>
+bool KCASLockFree<MAX_K>::casSingleWord(kcasentry_t * entry) {
+    while (true) {
+        KCAS_STATS ++stats[kcas_tid.getId()].cas;
+        casword_t r = VAL_CAS(entry->addr, entry->oldval, entry->newval);
+        if (r == entry->oldval) return true;
+        if (isRdcss(r)) {
+            rdcssHelpOther((rdcsstagptr_t) r);
+        } else if (isKcas(r)) {
+            helpOther((kcastagptr_t) r);
+        } else {
+            return false;
         }
     }
 }
 
+#define KCAS_OPTIMISTIC_ABORTED (-1)
+
+// try to perform the kcas desc (whose entries are sorted) without RDCSS: install its descriptor in each word with
+// a plain CAS while it is in the OPTIMISTIC state, in which no helper installs it. a late CAS (after a helper aborted
+// the kcas) replaced the old value, which phase 2 of an aborted kcas writes back, so it is harmless.
+// returns whether the kcas succeeded, or KCAS_OPTIMISTIC_ABORTED if it must be retried with the normal protocol.
+template <int MAX_K>
+int KCASLockFree<MAX_K>::executeOptimistic(kcasptr_t desc) {
+    const int tid = kcas_tid.getId();
+    desc->seqBits = (desc->seqBits & ~KCAS_SEQBITS_MASK_STATE) | (KCAS_STATE_OPTIMISTIC << KCAS_SEQBITS_OFFSET_STATE);
+    DESC_INITIALIZED(kcasDescriptors, tid);
+    kcastagptr_t tagptr = TAGPTR_NEW(tid, desc->seqBits, KCAS_TAGBIT);
+
+    int i = 0;
+    casword_t r = 0;
+    for (; i < desc->numEntries; i++) {
+        KCAS_STATS ++stats[tid].cas;
+        r = VAL_CAS(desc->entries[i].addr, desc->entries[i].oldval, (casword_t) tagptr);
+        if (r != desc->entries[i].oldval) break;
+    }
+    const bool installed = (i == desc->numEntries);
+    const int newstate = !installed ? KCAS_STATE_FAILED : desc->numReadOnly ? KCAS_STATE_READ_CHECK : KCAS_STATE_SUCCEEDED;
+    bool successBit;
+    KCAS_STATS ++stats[tid].cas;
+    SEQBITS_CAS_FIELD(successBit
+    , desc->seqBits, tagptr
+    , KCAS_STATE_OPTIMISTIC, newstate
+    , KCAS_SEQBITS_MASK_STATE, KCAS_SEQBITS_OFFSET_STATE);
+    const bool aborted = !successBit || (!installed && (isRdcss(r) || isKcas(r)));
+
+    bool result = help(tagptr, desc, false); // check read-only entries, and write back new (or old) values
+    return aborted ? KCAS_OPTIMISTIC_ABORTED : result;
+}
+
 template <int MAX_K>
 bool KCASLockFree<MAX_K>::execute() {
     assert(kcas_tid.getId() != -1);
     auto desc = &kcasDescriptors[kcas_tid.getId()];
-    // sort entries in the kcas descriptor to guarantee progress
+    if (kcasLockReadOnlyEntries) {
+        while (desc->numReadOnly) {
+            desc->entries[desc->numEntries++] = desc->entries[MAX_K - desc->numReadOnly--];
+        }
+    }
+    KCAS_STATS ++stats[kcas_tid.getId()].executions;
+    if (kcasSingleWordCAS && desc->numEntries == 1 && desc->numReadOnly == 0) {
+        return casSingleWord(&desc->entries[0]);
+    }
+    // sort entries in the kcas descriptor to guarantee progress (read-only entries are not locked, so need no order)
     kcasdesc_sort<MAX_K>(desc);
+    if (kcasOptimistic) {
+        int result = executeOptimistic(desc);
+        if (result != KCAS_OPTIMISTIC_ABORTED) return result;
+        desc = DESC_NEW(kcasDescriptors, KCAS_SEQBITS_NEW, kcas_tid.getId()); // same entries, new sequence number
+    }
     DESC_INITIALIZED(kcasDescriptors, kcas_tid.getId());
     kcastagptr_t tagptr = TAGPTR_NEW(kcas_tid.getId(), desc->seqBits, KCAS_TAGBIT);
 
@@ -487,6 +710,7 @@ void KCASLockFree<MAX_K>::start() {
     // allocate a new kcas descriptor
     kcasptr_t ptr = DESC_NEW(kcasDescriptors, KCAS_SEQBITS_NEW, kcas_tid.getId());
     ptr->numEntries = 0;
+    ptr->numReadOnly = 0;
 }
 
 template <int MAX_K>
@@ -511,3 +735,27 @@ void KCASLockFree<MAX_K>::add(casword<T> * caswordptr, T oldVal, T newVal, Args.
     caswordptr->addToDescriptor(oldVal, newVal);
     add(args...);
 }
+template<int MAX_K>
+template<typename T>
+void KCASLockFree<MAX_K>::addReadOnly(casword<T> * caswordptr, T val) {
+    caswordptr->addReadOnlyToDescriptor(val);
+}
+template<int MAX_K>
+template<typename T, typename... Args>
+void KCASLockFree<MAX_K>::addReadOnly(casword<T> * caswordptr, T val, Args... args) {
+    caswordptr->addReadOnlyToDescriptor(val);
+    addReadOnly(args...);
+}
+
+// print the number of kcas operations executed, and of CAS instructions they (and their helpers) performed,
+// since the last call
+template <int MAX_K>
+void KCASLockFree<MAX_K>::printStats() {
+    long long executions = 0, cas = 0;
+    for (int tid = 0; tid < KCAS_MAX_THREADS; ++tid) {
+        executions += stats[tid].executions;
+        cas += stats[tid].cas;
+    }
+    memset(stats, 0, sizeof(stats));
+    KCAS_STATS cout<<"kcas_executions="<<executions<<" kcas_cas="<<cas<<" cas_per_kcas="<<(executions ? (double) cas / executions : 0)<<endl;
+}
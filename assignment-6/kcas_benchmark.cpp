@@ -0,0 +1,153 @@
+/**
+ * A micro-benchmark for the cost of one update with kcas::execute, for updates of k = 1..MAX_KCAS words,
+ * with the KCAS instance of the external tree (MAX_KCAS 6). Each update increments k words (each in its own cache
+ * line), in each of three modes:
+ *  - descriptor: every kcas uses the full descriptor protocol (RDCSS per word),
+ *  - fastpath:   a kcas that changes one word is a single CAS (kcasSingleWordCAS, the default),
+ *  - optimistic: fastpath, and other kcas first try to install their descriptor with plain CAS (kcasOptimistic).
+ * By default every thread updates its own words; with -w, all threads update k consecutive words (from a random
+ * start) of one shared array of -w words, so updates conflict.
+ * With -order, the entries of each kcas are added in address order (sorted, the default), in reverse address order,
+ * or in a random order (unsorted), which shows the cost of sorting them (kcasdesc_sort), like ../assignment-5/kcas_benchmark.
+ * (Build kcas_benchmark_stats to also print the number of CAS instructions per kcas.)
+ */
+
+#include <thread>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <algorithm>
+
+#include "defines.h"
+#include "util.h"
+
+#define MAX_KCAS 6
+#include "kcas/kcas.h"
+
+using namespace std;
+
+enum kcas_mode_t { MODE_DESCRIPTOR, MODE_FASTPATH, MODE_OPTIMISTIC };
+const char * modeNames[] = { "descriptor", "fastpath", "optimistic" };
+
+enum entry_order_t { ORDER_SORTED, ORDER_REVERSE, ORDER_UNSORTED };
+const char * orderNames[] = { "sorted", "reverse", "unsorted" };
+
+#define NUM_PERMUTATIONS 64
+
+struct paddedword_t {
+    casword<long> word;
+    volatile char padding[PADDING_BYTES-sizeof(casword<long>)];
+};
+
+// NUM_PERMUTATIONS orders in which the entries of a kcas on k consecutive words are added
+vector<vector<int>> makeOrders(entry_order_t order, int k) {
+    vector<vector<int>> orders(NUM_PERMUTATIONS, vector<int>(k));
+    mt19937 rng(12345);
+    for (auto & perm : orders) {
+        for (int i=0;i<k;++i) {
+            perm[i] = (order == ORDER_REVERSE) ? k-1-i : i;
+        }
+        if (order == ORDER_UNSORTED) shuffle(perm.begin(), perm.end(), rng);
+    }
+    return orders;
+}
+
+void runK(kcas_mode_t mode, int k, entry_order_t order, int numThreads, int numSharedWords, int iterations) {
+    kcasSingleWordCAS = (mode != MODE_DESCRIPTOR);
+    kcasOptimistic = (mode == MODE_OPTIMISTIC);
+
+    const int numWords = numSharedWords ? numSharedWords : numThreads * MAX_KCAS;
+    auto words = new paddedword_t[numWords];
+    for (int i=0;i<numWords;++i) words[i].word.setInitVal(0);
+    long successes[MAX_THREADS] = {};
+    auto orders = makeOrders(order, k);
+
+    auto start = chrono::high_resolution_clock::now();
+    vector<thread> threads;
+    for (int tid=0;tid<numThreads;++tid) {
+        threads.push_back(thread([&, tid]() {
+            PaddedRandom rng(tid + 1);
+            for (int it=0;it<iterations;++it) {
+                const int first = numSharedWords ? rng.nextNatural() % numSharedWords : tid * MAX_KCAS;
+                auto & perm = orders[it % NUM_PERMUTATIONS];
+                kcas::start();
+                for (int i=0;i<k;++i) {
+                    auto word = &words[(first + perm[i]) % numWords].word;
+                    long val = *word;
+                    kcas::add(word, val, val + 1);
+                }
+                if (kcas::execute()) ++successes[tid];
+            }
+        }));
+    }
+    for (auto & t : threads) t.join();
+    auto nanos = chrono::duration_cast<chrono::nanoseconds>(chrono::high_resolution_clock::now() - start).count();
+
+    long totalSuccesses = 0, sum = 0;
+    for (int tid=0;tid<numThreads;++tid) totalSuccesses += successes[tid];
+    for (int i=0;i<numWords;++i) sum += words[i].word;
+    if (sum != totalSuccesses * k) {
+        cout<<"ERROR: the words sum to "<<sum<<" after "<<totalSuccesses<<" successful kcas on "<<k<<" words"<<endl;
+        exit(1);
+    }
+    cout<<"mode="<<modeNames[mode]<<" k="<<k<<" order="<<orderNames[order]<<" ns_per_update="<<(double) nanos / iterations;
+    cout<<" success_rate="<<(double) totalSuccesses / ((long) iterations * numThreads)<<endl;
+    kcas::printStats();
+    delete[] words;
+}
+
+int main(int argc, char** argv) {
+    int iterations = 1000000;
+    int numThreads = 1;
+    int numSharedWords = 0;
+    entry_order_t order = ORDER_SORTED;
+
+    for (int i=1;i<argc;++i) {
+        if (strcmp(argv[i], "-n") == 0) {
+            iterations = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-t") == 0) {
+            numThreads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-w") == 0) {
+            numSharedWords = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-order") == 0) {
+            ++i;
+            if (strcmp(argv[i], "sorted") == 0) order = ORDER_SORTED;
+            else if (strcmp(argv[i], "reverse") == 0) order = ORDER_REVERSE;
+            else if (strcmp(argv[i], "unsorted") == 0) order = ORDER_UNSORTED;
+            else {
+                cout<<"ERROR: unknown entry order "<<argv[i]<<endl;
+                return 1;
+            }
+        } else {
+            cout<<"USAGE: "<<argv[0]<<" [options]"<<endl;
+            cout<<"Options:"<<endl;
+            cout<<"    -n [int]     number of updates per thread for each mode and k (default 1000000)"<<endl;
+            cout<<"    -t [int]     number of threads (default 1)"<<endl;
+            cout<<"    -w [int]     number of words shared by all threads (default 0: each thread updates its own words)"<<endl;
+            cout<<"    -order [string] order in which entries are added: sorted, reverse or unsorted (default sorted)"<<endl;
+            return 1;
+        }
+    }
+    PRINT(iterations);
+    PRINT(numThreads);
+    PRINT(numSharedWords);
+    PRINT(orderNames[order]);
+    cout<<endl;
+
+    if (numThreads < 1 || numThreads >= MAX_THREADS) {
+        cout<<"ERROR: -t must be in [1, "<<MAX_THREADS-1<<"]"<<endl;
+        return 1;
+    }
+    if (numSharedWords && numSharedWords < MAX_KCAS) {
+        cout<<"ERROR: -w must be 0 or at least "<<MAX_KCAS<<endl;
+        return 1;
+    }
+
+    for (int mode=MODE_DESCRIPTOR;mode<=MODE_OPTIMISTIC;++mode) {
+        for (int k=1;k<=MAX_KCAS;++k) runK((kcas_mode_t) mode, k, order, numThreads, numSharedWords, iterations);
+    }
+    return 0;
+}
@@ -127,7 +127,7 @@ bool ExternalKCAS::insertIfAbsent(const int tid, const int & key) {
 
 
 		kcas::start();
-		kcas::add(&ret.p->marked, false, false);
+		kcas::addReadOnly(&ret.p->marked, false);
 		if(ret.p->left == ret.n){
 			kcas::add(&ret.p->left, ret.n, n1);
 		}
@@ -173,8 +173,8 @@ bool ExternalKCAS::erase(const int tid, const int & key) {
         if (dir != 0) return false;
 
 		kcas::start();
-		kcas::add(&ret.gp->marked, false, false,
-				  &ret.p->marked,  false, true,
+		kcas::addReadOnly(&ret.gp->marked, false);
+		kcas::add(&ret.p->marked,  false, true,
 				  &ret.n->marked,  false, true);
                 
         
@@ -184,9 +184,9 @@ bool ExternalKCAS::erase(const int tid, const int & key) {
         auto node = (ret.p->left == ret.n) ? &ret.p->left : &ret.p->right;
         Node * sib = (ret.p->left == ret.n) ? ret.p->right : ret.p->left;
 
-        kcas::add(parent, ret.p, sib,
-                 node, ret.n, ret.n,
-                 sibling, sib, sib);
+        kcas::add(parent, ret.p, sib);
+        kcas::addReadOnly(node, ret.n,
+                          sibling, sib);
         
         /*
 		Node * sibling = (ret.p->left == ret.n) ? ret.p->right : ret.p->left;
@@ -262,7 +262,9 @@ long ExternalKCAS::getSumOfKeys() {
 	return getSumOfKeysInSubtree(root);	
 }
 
-void ExternalKCAS::printDebuggingDetails() {}
+void ExternalKCAS::printDebuggingDetails() {
+    kcas::printStats();
+}
 
 void ExternalKCAS::freeSubtree(const int tid, Node * node) {
     if (node == NULL) return;
@@ -139,7 +139,7 @@ bool ExternalKCASReclaim::insertIfAbsent(const int tid, const int & key) {
 
 
 		kcas::start();
-		kcas::add(&ret.p->marked, false, false);
+		kcas::addReadOnly(&ret.p->marked, false);
 		if(ret.p->left == ret.n){
 			kcas::add(&ret.p->left, ret.n, n1);
 		}
@@ -186,8 +186,8 @@ bool ExternalKCASReclaim::erase(const int tid, const int & key) {
         if (dir != 0) return false;
 
 		kcas::start();
-		kcas::add(&ret.gp->marked, false, false,
-				  &ret.p->marked,  false, true,
+		kcas::addReadOnly(&ret.gp->marked, false);
+		kcas::add(&ret.p->marked,  false, true,
 				  &ret.n->marked,  false, true);
         
         auto parent = (ret.gp->left == ret.p) ? &ret.gp->left : &ret.gp->right;
@@ -195,9 +195,9 @@ bool ExternalKCASReclaim::erase(const int tid, const int & key) {
         auto node = (ret.p->left == ret.n) ? &ret.p->left : &ret.p->right;
         Node * sib = (ret.p->left == ret.n) ? ret.p->right : ret.p->left;
 
-        kcas::add(parent, ret.p, sib,
-                 node, ret.n, ret.n,
-                 sibling, sib, sib);
+        kcas::add(parent, ret.p, sib);
+        kcas::addReadOnly(node, ret.n,
+                          sibling, sib);
 
 		/*Node * sibling = (ret.p->left == ret.n) ? ret.p->right : ret.p->left;
 		if(ret.gp->left == ret.p && ret.p->left == ret.n){
@@ -275,7 +275,9 @@ long ExternalKCASReclaim::getSumOfKeys() {
 	return getSumOfKeysInSubtree(root);	
 }
 
-void ExternalKCASReclaim::printDebuggingDetails() {}
+void ExternalKCASReclaim::printDebuggingDetails() {
+    kcas::printStats();
+}
 
 void ExternalKCASReclaim::freeSubtree(const int tid, Node * node) {
     if (node == NULL) return;
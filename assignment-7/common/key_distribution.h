@@ -0,0 +1,191 @@
+/**
+ * Key distributions for the set benchmarks (see set_benchmark.h).
+ *
+ * Keys are drawn from [1, keyRangeSize] according to one of:
+ *  uniform         every key is equally likely
+ *  zipf[:theta]    Zipfian with skew theta in [0, 1) (default 0.99), using the generator of
+ *                  Gray et al., "Quickly generating billion-record synthetic databases" (as in YCSB).
+ *                  ranks are scrambled over the key range by a multiplicative permutation,
+ *                  so the hottest keys are not adjacent.
+ *  hot[:K[:O]]     hot set / cold set: O% of operations (default 80) go to the first K% of keys
+ *                  (default 20), and the rest go to the other keys (both uniformly)
+ *  sequential      each thread walks the key range in order (thread tid uses keys tid+1, tid+1+n, ...)
+ *  latest[:theta]  inserts walk the key range like sequential, and other operations use keys a Zipfian (theta)
+ *                  distance behind the most recently inserted key (as in YCSB workload D). each thread only
+ *                  advances its own cursor, and estimates the most recent key from it (threads insert at about
+ *                  the same rate), so that the cursors are not a point of contention.
+ */
+
+#pragma once
+
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include <cstdint>
+#include <cmath>
+#include <numeric>
+#include <limits>
+#include <iostream>
+#include <sstream>
+
+using namespace std;
+
+enum key_dist_t { DIST_UNIFORM, DIST_ZIPF, DIST_HOTSET, DIST_SEQUENTIAL, DIST_LATEST };
+
+struct key_dist_config_t {
+    key_dist_t type = DIST_UNIFORM;
+    double theta = 0.99;
+    double hotKeysPercent = 20;
+    double hotOpsPercent = 80;
+
+    // parse a distribution description, e.g., "zipf:0.9" or "hot:10:90". returns false if it is malformed.
+    bool parse(const char * s) {
+        const char * params = strchr(s, ':');
+        size_t len = params ? (size_t) (params - s) : strlen(s);
+        if (params) ++params;
+        if (!strncmp(s, "uniform", len) && len == 7) {
+            type = DIST_UNIFORM;
+        } else if (!strncmp(s, "zipf", len) && len == 4) {
+            type = DIST_ZIPF;
+            if (params) theta = atof(params);
+        } else if (!strncmp(s, "hot", len) && len == 3) {
+            type = DIST_HOTSET;
+            if (params) {
+                hotKeysPercent = atof(params);
+                const char * p2 = strchr(params, ':');
+                if (p2) hotOpsPercent = atof(p2+1);
+            }
+        } else if (!strncmp(s, "sequential", len) && len == 10) {
+            type = DIST_SEQUENTIAL;
+        } else if (!strncmp(s, "latest", len) && len == 6) {
+            type = DIST_LATEST;
+            if (params) theta = atof(params);
+        } else {
+            return false;
+        }
+        if ((type == DIST_ZIPF || type == DIST_LATEST) && (theta < 0 || theta >= 1)) return false;
+        if (type == DIST_HOTSET && (hotKeysPercent <= 0 || hotKeysPercent >= 100 || hotOpsPercent < 0 || hotOpsPercent > 100)) return false;
+        return true;
+    }
+
+    string toString() const {
+        stringstream ss;
+        switch (type) {
+            case DIST_ZIPF: ss<<"zipf:"<<theta; break;
+            case DIST_HOTSET: ss<<"hot:"<<hotKeysPercent<<":"<<hotOpsPercent; break;
+            case DIST_SEQUENTIAL: ss<<"sequential"; break;
+            case DIST_LATEST: ss<<"latest:"<<theta; break;
+            default: ss<<"uniform"; break;
+        }
+        return ss.str();
+    }
+};
+
+// returns ranks in [0, n) where rank i has probability proportional to 1/(i+1)^theta.
+// construction takes O(n) time (to compute zeta(n, theta)), and next() takes O(1) time.
+class ZipfGenerator {
+private:
+    int64_t n;
+    double theta;
+    double alpha;
+    double zetan;
+    double eta;
+    double halfPowTheta;
+
+    static double zeta(int64_t n, double theta) {
+        double sum = 0;
+        for (int64_t i=1;i<=n;++i) sum += 1. / pow((double) i, theta);
+        return sum;
+    }
+public:
+    ZipfGenerator() : n(0) {}
+    void init(int64_t _n, double _theta) {
+        n = _n;
+        theta = _theta;
+        alpha = 1. / (1. - theta);
+        zetan = zeta(n, theta);
+        halfPowTheta = pow(0.5, theta);
+        double zeta2 = 1. + halfPowTheta;
+        eta = (1. - pow(2. / n, 1. - theta)) / (1. - zeta2 / zetan);
+    }
+    // u must be uniformly distributed in [0, 1)
+    int64_t next(double u) {
+        double uz = u * zetan;
+        if (uz < 1.) return 0;
+        if (uz < 1. + halfPowTheta) return 1;
+        int64_t result = (int64_t) (n * pow(eta * u - eta + 1., alpha));
+        return (result < n) ? result : n-1;
+    }
+};
+
+class KeyDistribution {
+private:
+    struct padded_cursor {
+        volatile char padding[PADDING_BYTES - sizeof(int64_t)];
+        int64_t v;
+    };
+
+    const key_dist_config_t cfg;
+    const int64_t keyRangeSize;
+    const int totalThreads;
+    int64_t hotKeys;
+    uint64_t hotOpsThreshold;   // an operation is on a hot key if a random 32-bit number is below this
+    uint64_t scrambleMultiplier;
+    ZipfGenerator zipf;
+    padded_cursor cursors[MAX_THREADS]; // per-thread position in the key range (sequential and latest)
+    volatile char padding0[PADDING_BYTES];
+
+    // u uniformly distributed in [0, 1)
+    static double nextUnit(PaddedRandom & rng) {
+        return rng.nextNatural() / ((double) numeric_limits<unsigned int>::max() + 1.);
+    }
+public:
+    KeyDistribution(const key_dist_config_t & _cfg, int _keyRangeSize, int _totalThreads)
+            : cfg(_cfg), keyRangeSize(_keyRangeSize), totalThreads(_totalThreads) {
+        hotKeys = max((int64_t) 1, (int64_t) (keyRangeSize * cfg.hotKeysPercent / 100));
+        hotOpsThreshold = (uint64_t) (cfg.hotOpsPercent / 100 * ((uint64_t) numeric_limits<unsigned int>::max() + 1));
+        // any multiplier coprime to keyRangeSize gives a permutation of [0, keyRangeSize)
+        scrambleMultiplier = 2654435761ULL % keyRangeSize;
+        while (gcd(scrambleMultiplier, (uint64_t) keyRangeSize) != 1) ++scrambleMultiplier;
+        if (cfg.type == DIST_ZIPF || cfg.type == DIST_LATEST) {
+            zipf.init(keyRangeSize, cfg.theta);
+        }
+        reset();
+    }
+
+    // restart the sequential and latest cursors (called before each trial)
+    void reset() {
+        for (int i=0;i<MAX_THREADS;++i) cursors[i].v = 0;
+    }
+
+    // returns a key in [1, keyRangeSize]. isInsert is only used by the latest distribution.
+    int nextKey(const int tid, PaddedRandom & rng, bool isInsert) {
+        switch (cfg.type) {
+            case DIST_ZIPF: {
+                uint64_t rank = zipf.next(nextUnit(rng));
+                return (int) (1 + (rank * scrambleMultiplier) % keyRangeSize);
+            }
+            case DIST_HOTSET: {
+                if (rng.nextNatural() < hotOpsThreshold || hotKeys == keyRangeSize) {
+                    return (int) (1 + rng.nextNatural() % hotKeys);
+                }
+                return (int) (1 + hotKeys + rng.nextNatural() % (keyRangeSize - hotKeys));
+            }
+            case DIST_SEQUENTIAL: {
+                int64_t c = cursors[tid].v++;
+                return (int) (1 + (c * totalThreads + tid) % keyRangeSize);
+            }
+            case DIST_LATEST: {
+                if (isInsert) {
+                    int64_t c = cursors[tid].v++;
+                    return (int) (1 + (c * totalThreads + tid) % keyRangeSize);
+                }
+                int64_t distance = zipf.next(nextUnit(rng));
+                int64_t newest = cursors[tid].v * totalThreads - 1; // about as many keys as all threads inserted
+                return (int) (1 + ((newest - distance) % keyRangeSize + keyRangeSize) % keyRangeSize);
+            }
+            default:
+                return (int) (1 + rng.nextNatural() % keyRangeSize);
+        }
+    }
+};
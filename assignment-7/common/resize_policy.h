@@ -0,0 +1,53 @@
+/**
+ * Resize policy for open addressing hash tables that leave tombstones behind when keys are erased.
+ *
+ * The policy looks at the number of live keys and the number of used buckets (live keys + tombstones):
+ *  - if used > maxLoadFactor * capacity, the table is rebuilt. the new capacity is live / targetLoadFactor,
+ *    so it grows if there are too many live keys, shrinks if most used buckets are tombstones, and otherwise
+ *    stays the same (i.e., the rebuild just cleans up the tombstones).
+ *  - if live < minLoadFactor * capacity, the table is shrunk to capacity live / targetLoadFactor.
+ * capacity never drops below minCapacity.
+ * with the default factors, a table is at load 1/4 after a rebuild, and is rebuilt when its load drops
+ * below 1/8 or its used buckets exceed 1/2, so each rebuild is amortized over at least capacity/8 operations.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <algorithm>
+
+enum resize_action_t { RESIZE_NONE, RESIZE_GROW, RESIZE_SHRINK, RESIZE_CLEANUP };
+
+struct resize_policy_t {
+    double minLoadFactor = 0.125;       // 0 disables shrinking
+    double maxLoadFactor = 0.5;
+    double targetLoadFactor = 0.25;     // load factor (live / capacity) right after a rebuild
+    int64_t minCapacity = 0;            // 0 means the initial capacity of the table
+
+    // returns the capacity a table with this many live keys should be rebuilt with
+    int64_t getNewCapacity(int64_t live) const {
+        return std::max(minCapacity, (int64_t) (live / targetLoadFactor) + 1);
+    }
+
+    resize_action_t getAction(int64_t capacity, int64_t live, int64_t used) const {
+        if (used > maxLoadFactor * capacity) {
+            auto newCapacity = getNewCapacity(live);
+            if (newCapacity > capacity) return RESIZE_GROW;
+            if (newCapacity <= capacity / 2) return RESIZE_SHRINK;
+            return RESIZE_CLEANUP;
+        }
+        if (live < minLoadFactor * capacity && capacity > minCapacity && getNewCapacity(live) <= capacity / 2) {
+            return RESIZE_SHRINK;
+        }
+        return RESIZE_NONE;
+    }
+
+    static const char * toString(resize_action_t action) {
+        switch (action) {
+            case RESIZE_GROW: return "grow";
+            case RESIZE_SHRINK: return "shrink";
+            case RESIZE_CLEANUP: return "cleanup";
+            default: return "none";
+        }
+    }
+};
@@ -0,0 +1,571 @@
+/**
+ * A header-only timed-trial benchmark framework for data structures that implement a set,
+ * shared by the benchmarks of all assignments.
+ *
+ * The data structure type must provide:
+ *      bool insertIfAbsent(const int tid, const int & key);
+ *      bool erase(const int tid, const int & key);
+ *      long getSumOfKeys();                                // used to validate the key checksum
+ *      void printDebuggingDetails();
+ * and optionally:
+ *      bool contains(const int tid, const int & key);      // required if insertPercent + deletePercent < 100
+ *      void insertBatch(const int tid, const int * keys, const int n, bool * results);   // these three are
+ *      void eraseBatch(const int tid, const int * keys, const int n, bool * results);    // required if batchSize > 1
+ *      void containsBatch(const int tid, const int * keys, const int n, bool * results);
+ *      int64_t sumKeys(const int tid, const int numScanThreads);  // required if scanThreads > 0
+ *      int rangeQuery(const int tid, const int & lo, const int & hi, int * out);  // required if rangeQueryPercent > 0
+ *      static const int rangeQueryMaxKeys;                 // widest range rangeQuery supports (default: any)
+ *
+ * Methodology (identical for every data structure):
+ *  1. for each trial, a fresh data structure is created (via a factory function)
+ *  2. optionally, it is prefilled to its steady state size (keyRangeSize * insert / (insert + delete))
+ *     (prefilling always draws keys uniformly, which reaches the same steady state size for any key distribution)
+ *  3. the measured workload runs for warmupMillis, and the operations it performs are discarded
+ *  4. the measured workload runs for millisToRun, and throughput is recorded
+ *     (with -alternate N, it is split into N phases that alternate between the configured insert/delete mix and
+ *      the mirrored mix, e.g., 90/10 then 10/90, so the data structure repeatedly grows and shrinks; after each
+ *      phase, its throughput, the resident set size and the data structure's debugging details are printed)
+ *  5. the sum of keys in the data structure is validated against the threads' key checksum
+ * keys of the warm-up and measured phases are drawn from the distribution selected with -dist (see key_distribution.h).
+ * with -batch N, threads perform operations in batches of N keys (all of the same operation type).
+ * with -scan N, the main thread repeatedly runs sumKeys with N scan threads during the measured phase
+ * (concurrently with the updates), and the number and average duration of scans are reported.
+ * with -rq P, P% of the operations (taken from the contains share) are range queries of -rqwidth consecutive keys,
+ * and the number of range queries and average number of keys they return are reported.
+ * random seeds depend only on the trial number and the thread id, so runs are reproducible
+ * (up to thread interleaving), and threads can be pinned with -pin (see binding.h).
+ * results of all trials, and their mean and standard deviation, are printed as text, CSV or JSON.
+ *
+ * Usage: include util.h (for ElapsedTimer, PaddedRandom, debugCounter) before this file,
+ * parse the common options with benchmark_config_t::parseArg, call binding_configurePolicy,
+ * then call SetBenchmark<DataStructureType>::run(config, factory).
+ */
+
+#pragma once
+
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
+#include <ctime>
+#include <limits>
+#include <iostream>
+#include <type_traits>
+#include <utility>
+#include <cstdio>
+#include <unistd.h>
+
+#include "binding.h"
+#include "key_distribution.h"
+
+using namespace std;
+
+enum benchmark_format_t { FORMAT_TEXT, FORMAT_CSV, FORMAT_JSON };
+
+struct benchmark_config_t {
+    const char * name = "ds";       // data structure name (used in the output)
+    int totalThreads = 0;
+    int keyRangeSize = 0;           // keys are drawn from [1, keyRangeSize]
+    int millisToRun = 1000;
+    int warmupMillis = 0;
+    int numTrials = 1;
+    double insertPercent = 50;
+    double deletePercent = 50;      // (100 - insertPercent - deletePercent)% of operations are contains
+    bool prefill = true;
+    key_dist_config_t dist;         // distribution of keys in the warm-up and measured phases
+    benchmark_format_t format = FORMAT_TEXT;
+    int batchSize = 1;              // number of keys per (batched) operation in the warm-up and measured phases
+    int alternatePhases = 0;        // if > 1, the measured phase alternates between the insert/delete mix and its mirror
+    int scanThreads = 0;            // if > 0, scan the data structure with this many threads during the measured phase
+    double rangeQueryPercent = 0;   // percent of operations that are range queries (the rest of the contains share are contains)
+    int rangeQueryWidth = 100;      // number of keys in the range of each range query
+
+    // if argv[i] is one of the options common to all benchmarks, consume it (and its argument) and return true
+    bool parseArg(int argc, char ** argv, int & i) {
+        if (strcmp(argv[i], "-trials") == 0 && i+1 < argc) {
+            numTrials = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-warmup") == 0 && i+1 < argc) {
+            warmupMillis = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-prefill") == 0 && i+1 < argc) {
+            prefill = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-format") == 0 && i+1 < argc) {
+            ++i;
+            if (strcmp(argv[i], "csv") == 0) format = FORMAT_CSV;
+            else if (strcmp(argv[i], "json") == 0) format = FORMAT_JSON;
+            else format = FORMAT_TEXT;
+        } else if (strcmp(argv[i], "-dist") == 0 && i+1 < argc) {
+            if (!dist.parse(argv[++i])) {
+                cout<<"bad key distribution: "<<argv[i]<<endl;
+                exit(1);
+            }
+        } else if (strcmp(argv[i], "-batch") == 0 && i+1 < argc) {
+            batchSize = atoi(argv[++i]);
+            if (batchSize < 1) {
+                cout<<"bad batch size: "<<argv[i]<<endl;
+                exit(1);
+            }
+        } else if (strcmp(argv[i], "-scan") == 0 && i+1 < argc) {
+            scanThreads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-rq") == 0 && i+1 < argc) {
+            rangeQueryPercent = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-rqwidth") == 0 && i+1 < argc) {
+            rangeQueryWidth = atoi(argv[++i]);
+            if (rangeQueryWidth < 1) {
+                cout<<"bad range query width: "<<argv[i]<<endl;
+                exit(1);
+            }
+        } else if (strcmp(argv[i], "-alternate") == 0 && i+1 < argc) {
+            alternatePhases = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-pin") == 0 && i+1 < argc) { // e.g., "-pin 1,2,3,8-11,4-7,0"
+            binding_parseCustom(argv[++i]);
+            std::cout<<"parsed custom binding: "<<argv[i]<<std::endl;
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+    static void printUsage() {
+        cout<<"Options common to all benchmarks:"<<endl;
+        cout<<"    -trials [int]   number of trials to run (default 1); mean and stdev of throughput are reported"<<endl;
+        cout<<"    -warmup [int]   milliseconds of warm-up (not measured) before each trial (default 0)"<<endl;
+        cout<<"    -prefill [0|1]  prefill the data structure to its steady state size before each trial"<<endl;
+        cout<<"    -format [string] output format: text, csv or json (default text)"<<endl;
+        cout<<"    -dist [string]  key distribution: uniform (default), zipf[:theta], hot[:hotKeysPercent[:hotOpsPercent]],"<<endl;
+        cout<<"                    sequential or latest[:theta] (e.g., -dist zipf:0.99 or -dist hot:20:80)"<<endl;
+        cout<<"    -batch [int]    perform operations in batches of [int] keys of the same type (default 1, i.e., no batching)"<<endl;
+        cout<<"    -scan [int]     during the measured phase, the main thread repeatedly sums the keys with [int] threads"<<endl;
+        cout<<"    -rq [double]    percent of operations that are range queries (taken from the contains percent)"<<endl;
+        cout<<"    -rqwidth [int]  number of consecutive keys in the range of each range query (default 100)"<<endl;
+        cout<<"    -alternate [int] split the measured phase into [int] phases, alternating between the insert/delete mix"<<endl;
+        cout<<"                    and its mirror (insert and delete percentages swapped), printing throughput, RSS and"<<endl;
+        cout<<"                    data structure details after each phase"<<endl;
+        cout<<"    -pin [pattern]  pin threads to logical processors according to [pattern], e.g., -pin 0-23,48-71,24-47,72-95"<<endl;
+    }
+};
+
+// detects whether DataStructureType has contains(tid, key)
+template <class T, class = void>
+struct benchmark_has_contains : false_type {};
+template <class T>
+struct benchmark_has_contains<T, void_t<decltype(declval<T &>().contains(0, declval<const int &>()))>> : true_type {};
+
+// detects whether DataStructureType has insertBatch, eraseBatch and containsBatch
+template <class T, class = void>
+struct benchmark_has_batch : false_type {};
+template <class T>
+struct benchmark_has_batch<T, void_t<decltype(declval<T &>().insertBatch(0, (const int *) 0, 0, (bool *) 0)),
+                                     decltype(declval<T &>().eraseBatch(0, (const int *) 0, 0, (bool *) 0)),
+                                     decltype(declval<T &>().containsBatch(0, (const int *) 0, 0, (bool *) 0))>> : true_type {};
+
+// resident set size of this process, in bytes
+static int64_t getRSSBytes() {
+    int64_t pages = 0;
+    FILE * f = fopen("/proc/self/statm", "r");
+    if (f) {
+        if (fscanf(f, "%*d %ld", &pages) != 1) pages = 0;
+        fclose(f);
+    }
+    return pages * sysconf(_SC_PAGESIZE);
+}
+
+// detects whether DataStructureType has sumKeys(tid, numScanThreads)
+template <class T, class = void>
+struct benchmark_has_scan : false_type {};
+template <class T>
+struct benchmark_has_scan<T, void_t<decltype(declval<T &>().sumKeys(0, 0))>> : true_type {};
+
+// detects whether DataStructureType has rangeQuery(tid, lo, hi, out)
+template <class T, class = void>
+struct benchmark_has_range_query : false_type {};
+template <class T>
+struct benchmark_has_range_query<T, void_t<decltype(declval<T &>().rangeQuery(0, declval<const int &>(), declval<const int &>(), (int *) 0))>> : true_type {};
+
+// the widest range (in keys) that DataStructureType::rangeQuery supports
+template <class T, class = void>
+struct benchmark_range_query_max_keys : integral_constant<int, numeric_limits<int>::max()> {};
+template <class T>
+struct benchmark_range_query_max_keys<T, void_t<decltype(T::rangeQueryMaxKeys)>> : integral_constant<int, T::rangeQueryMaxKeys> {};
+
+struct benchmark_trial_result_t {
+    int64_t completedOperations;
+    int64_t elapsedMillis;
+    double throughput;
+    int64_t prefillSize;
+    bool validated;
+    int64_t numScans;
+    int64_t scanMillis;         // total time spent in scans
+};
+
+template <class DataStructureType>
+class SetBenchmark {
+private:
+    PaddedRandom rngs[MAX_THREADS];
+    volatile char padding0[PADDING_BYTES];
+    ElapsedTimer timer;
+    volatile char padding1[PADDING_BYTES];
+    volatile bool done;
+    volatile char padding2[PADDING_BYTES];
+    volatile bool start;        // used for a custom barrier implementation (should threads start yet?)
+    volatile char padding3[PADDING_BYTES];
+    atomic_int running;         // used for a custom barrier implementation (how many threads are waiting?)
+    volatile char padding4[PADDING_BYTES];
+    DataStructureType * ds;
+    KeyDistribution * keys;
+    debugCounter numTotalOps;   // already has padding built in at the beginning and end
+    debugCounter keyChecksum;
+    debugCounter sizeChecksum;
+    debugCounter numRangeQueries;
+    debugCounter rangeQueryKeys;    // total number of keys returned by range queries
+    bool scanning;              // should the main thread scan during runPhase?
+    int64_t numScans;
+    int64_t scanMillis;
+    const benchmark_config_t & cfg;
+    volatile char padding5[PADDING_BYTES];
+    size_t garbage; // garbage variable that will be useful for preventing some code from being optimized out
+    volatile char padding6[PADDING_BYTES];
+
+    SetBenchmark(const benchmark_config_t & _cfg, DataStructureType * _ds, KeyDistribution * _keys, int trial) : cfg(_cfg) {
+        for (int i=0;i<MAX_THREADS;++i) {
+            rngs[i].setSeed(trial * MAX_THREADS + i + 1); // never 0, since seeds of 0 usually mean all random numbers are zero...
+        }
+        done = false;
+        start = false;
+        running = 0;
+        ds = _ds;
+        keys = _keys;
+        keys->reset();
+        garbage = -1;
+        scanning = false;
+        numScans = 0;
+        scanMillis = 0;
+    }
+    ~SetBenchmark() {
+        delete ds;
+    }
+
+    // the work of thread tid in a phase with batchSize > 1: every batch draws batchSize keys and performs the same
+    // operation on all of them (chosen as for a single operation). returns the number of keys found by containsBatch.
+    size_t runBatches(const int tid, const long millisToRun, double insertPercent, double deletePercent, bool uniformKeys) {
+        const int BATCHES_BETWEEN_TIME_CHECKS = max(1, 500 / cfg.batchSize);
+        int * batchKeys = new int[cfg.batchSize];
+        bool * results = new bool[cfg.batchSize];
+        size_t garbage = 0;
+        for (int cnt=0; !done; ++cnt) {
+            if ((cnt % BATCHES_BETWEEN_TIME_CHECKS) == 0 && timer.getElapsedMillis() >= millisToRun) {
+                done = true;
+            }
+
+            double operationType = rngs[tid].nextNatural() / (double) numeric_limits<unsigned int>::max() * 100;
+            for (int i=0;i<cfg.batchSize;++i) {
+                batchKeys[i] = uniformKeys ? (int) (1 + (rngs[tid].nextNatural() % cfg.keyRangeSize))
+                                           : keys->nextKey(tid, rngs[tid], operationType < insertPercent);
+            }
+
+            if (operationType < insertPercent) {
+                ds->insertBatch(tid, batchKeys, cfg.batchSize, results);
+                for (int i=0;i<cfg.batchSize;++i) {
+                    if (results[i]) {
+                        keyChecksum.add(tid, batchKeys[i]);
+                        sizeChecksum.add(tid, 1);
+                    }
+                }
+            } else if (operationType < insertPercent + deletePercent) {
+                ds->eraseBatch(tid, batchKeys, cfg.batchSize, results);
+                for (int i=0;i<cfg.batchSize;++i) {
+                    if (results[i]) {
+                        keyChecksum.add(tid, -batchKeys[i]);
+                        sizeChecksum.add(tid, -1);
+                    }
+                }
+            } else {
+                ds->containsBatch(tid, batchKeys, cfg.batchSize, results);
+                for (int i=0;i<cfg.batchSize;++i) garbage += results[i];
+            }
+
+            numTotalOps.add(tid, cfg.batchSize);
+        }
+        delete[] batchKeys;
+        delete[] results;
+        return garbage;
+    }
+
+    // run all threads on the given operation mix for millisToRun, and return the elapsed time.
+    // keys are drawn from the configured distribution, or uniformly if uniformKeys is true.
+    int64_t runPhase(const long millisToRun, double insertPercent, double deletePercent, bool uniformKeys) {
+        done = false;
+        start = false;
+
+        // create and start threads
+        thread * threads[MAX_THREADS]; // just allocate an array for max threads to avoid changing data layout (which can affect results) when varying thread count.
+        for (int tid=0;tid<cfg.totalThreads;++tid) {
+            threads[tid] = new thread([&, tid]() { /* access all variables by reference, except tid, which we copy */
+                const int OPS_BETWEEN_TIME_CHECKS = 500; // only check the current time (to see if we should stop) once every X operations, to amortize the overhead of time checking
+                binding_bindThread(tid);
+                size_t garbage = 0; // will prevent contains() calls from being optimized out
+                vector<int> rangeQueryOut(cfg.rangeQueryPercent > 0 ? cfg.rangeQueryWidth : 0);
+
+                // BARRIER WAIT
+                running.fetch_add(1);
+                while (!start) { TRACE TPRINT("waiting to start"<<endl); }               // wait to start
+
+                if (cfg.batchSize > 1) {
+                    if constexpr (benchmark_has_batch<DataStructureType>::value) {
+                        garbage += runBatches(tid, millisToRun, insertPercent, deletePercent, uniformKeys);
+                    }
+                } else {
+                    for (int cnt=0; !done; ++cnt) {
+                        if ((cnt % OPS_BETWEEN_TIME_CHECKS) == 0                                // once every X operations
+                                && timer.getElapsedMillis() >= millisToRun) {               // check how much time has passed
+                            done = true; // first thread to stop dictates when everyone else stops --- at most one more operation is performed per thread!
+                        }
+
+                        // generate a random double in [0, 100] to decide the operation type
+                        double operationType = rngs[tid].nextNatural() / (double) numeric_limits<unsigned int>::max() * 100;
+
+                        // generate key in [1, keyRangeSize]
+                        int key = uniformKeys ? (int) (1 + (rngs[tid].nextNatural() % cfg.keyRangeSize))
+                                              : keys->nextKey(tid, rngs[tid], operationType < insertPercent);
+
+                        if (operationType < insertPercent) {
+                            if (ds->insertIfAbsent(tid, key)) {
+                                keyChecksum.add(tid, key);
+                                sizeChecksum.add(tid, 1);
+                            }
+                        } else if (operationType < insertPercent + deletePercent) {
+                            if (ds->erase(tid, key)) {
+                                keyChecksum.add(tid, -key);
+                                sizeChecksum.add(tid, -1);
+                            }
+                        } else if (operationType < insertPercent + deletePercent + cfg.rangeQueryPercent) {
+                            if constexpr (benchmark_has_range_query<DataStructureType>::value) {
+                                int hi = min(cfg.keyRangeSize, key + cfg.rangeQueryWidth - 1);
+                                int found = ds->rangeQuery(tid, key, hi, rangeQueryOut.data());
+                                garbage += found;
+                                numRangeQueries.inc(tid);
+                                rangeQueryKeys.add(tid, found);
+                            }
+                        } else {
+                            if constexpr (benchmark_has_contains<DataStructureType>::value) {
+                                garbage += ds->contains(tid, key); // "use" the return value of contains, so contains isn't optimized out
+                            }
+                        }
+
+                        numTotalOps.inc(tid);
+                    }
+                }
+
+                running.fetch_add(-1);
+                __sync_fetch_and_add(&this->garbage, garbage); // "use" the return values of all contains
+            });
+        }
+
+        while (running < cfg.totalThreads) {
+            TRACE cout<<"main thread: waiting for threads to START running="<<running<<endl;
+        }
+        timer.startTimer();
+        __sync_synchronize(); // prevent compiler from reordering "start = true;" before the timer start
+        start = true; // release all threads from the barrier, so they can work
+
+        if (scanning) {
+            // scan the data structure (as thread totalThreads) until the phase ends
+            if constexpr (benchmark_has_scan<DataStructureType>::value) {
+                while (!done) {
+                    auto scanStart = timer.getElapsedMillis();
+                    garbage += ds->sumKeys(cfg.totalThreads, cfg.scanThreads);
+                    scanMillis += timer.getElapsedMillis() - scanStart;
+                    ++numScans;
+                }
+            }
+        } else {
+            // sleep the main thread for length of time the phase should run
+            timespec ts;
+            ts.tv_sec = millisToRun / 1000;
+            ts.tv_nsec = 1000000 * (millisToRun % 1000);
+            nanosleep(&ts, NULL);
+        }
+
+        while (running > 0) { std::this_thread::yield(); /* wait for all threads to stop working */ }
+        int64_t elapsed = timer.getElapsedMillis();
+
+        // join all threads
+        for (int tid=0;tid<cfg.totalThreads;++tid) {
+            threads[tid]->join();
+            delete threads[tid];
+        }
+        return elapsed;
+    }
+
+    // run the measured workload as alternatePhases phases, where odd phases swap the insert and delete percentages
+    int64_t runAlternatingPhases() {
+        const long phaseMillis = max(1L, (long) cfg.millisToRun / cfg.alternatePhases);
+        int64_t elapsed = 0;
+        for (int phase=0;phase<cfg.alternatePhases;++phase) {
+            double ins = (phase % 2) ? cfg.deletePercent : cfg.insertPercent;
+            double del = (phase % 2) ? cfg.insertPercent : cfg.deletePercent;
+            auto opsBefore = numTotalOps.getTotal();
+            auto phaseElapsed = runPhase(phaseMillis, ins, del, false);
+            elapsed += phaseElapsed;
+            if (cfg.format == FORMAT_TEXT) {
+                cout<<"phase "<<phase<<" insertPercent="<<ins<<" deletePercent="<<del
+                    <<" throughput="<<(long long) ((numTotalOps.getTotal() - opsBefore) * 1000. / max((int64_t) 1, phaseElapsed))
+                    <<" size="<<sizeChecksum.getTotal()<<" rss="<<getRSSBytes()<<endl;
+                ds->printDebuggingDetails();
+            }
+        }
+        return elapsed;
+    }
+
+    // prefill to contain the steady state fraction of the key range (with 0% insert and 0% delete, we prefill to half full).
+    // returns false if this does not succeed in a reasonable time
+    bool prefillToSteadyState(ElapsedTimer & timerFromStart) {
+        double totalUpdatePercent = cfg.insertPercent + cfg.deletePercent;
+        double prefillingInsertPercent = (totalUpdatePercent < 1e-6) ? 50 : (cfg.insertPercent / totalUpdatePercent) * 100;
+        double prefillingDeletePercent = (totalUpdatePercent < 1e-6) ? 50 : (cfg.deletePercent / totalUpdatePercent) * 100;
+        auto expectedSize = cfg.keyRangeSize * prefillingInsertPercent / 100;
+        for (int attempts=0;;++attempts) {
+            runPhase(200, prefillingInsertPercent, prefillingDeletePercent, true);
+            if (cfg.format == FORMAT_TEXT) cout<<"prefilling round "<<attempts<<" ending size "<<sizeChecksum.getTotal()<<" total elapsed time="<<(timerFromStart.getElapsedMillis()/1000.)<<"s"<<endl;
+
+            if (sizeChecksum.getTotal() > 0.95 * expectedSize) {
+                if (cfg.format == FORMAT_TEXT) cout<<"prefilling completed to size "<<sizeChecksum.getTotal()<<" (within 5% of expected size "<<expectedSize<<" with key checksum "<<keyChecksum.getTotal()<<")"<<endl;
+                return true;
+            } else if (attempts > 100) {
+                cout<<"failed to prefill in a reasonable time to within an error of 5% of the expected size; final size "<<sizeChecksum.getTotal()<<" expected "<<expectedSize<<endl;
+                return false;
+            }
+        }
+    }
+
+    benchmark_trial_result_t runTrial(int trial, ElapsedTimer & timerFromStart) {
+        benchmark_trial_result_t result;
+        result.prefillSize = 0;
+        if (cfg.prefill && cfg.keyRangeSize > 2) {
+            if (!prefillToSteadyState(timerFromStart)) exit(-1);
+            result.prefillSize = sizeChecksum.getTotal();
+        }
+        if (cfg.warmupMillis > 0) {
+            runPhase(cfg.warmupMillis, cfg.insertPercent, cfg.deletePercent, false);
+        }
+        numTotalOps.clear(); // only count operations performed in the measured phase
+        numRangeQueries.clear();
+        rangeQueryKeys.clear();
+
+        if (cfg.format == FORMAT_TEXT) cout<<"main thread: trial "<<trial<<" starting..."<<endl;
+        scanning = (cfg.scanThreads > 0);
+        if (cfg.alternatePhases > 1) {
+            result.elapsedMillis = runAlternatingPhases();
+        } else {
+            result.elapsedMillis = runPhase(cfg.millisToRun, cfg.insertPercent, cfg.deletePercent, false);
+        }
+        scanning = false;
+        result.numScans = numScans;
+        result.scanMillis = scanMillis;
+
+        if (cfg.format == FORMAT_TEXT) ds->printDebuggingDetails();
+        result.completedOperations = numTotalOps.getTotal();
+        result.throughput = result.completedOperations * 1000. / max((int64_t) 1, result.elapsedMillis);
+
+        auto dsSumOfKeys = ds->getSumOfKeys();
+        auto threadsSumOfKeys = keyChecksum.getTotal();
+        result.validated = (dsSumOfKeys == threadsSumOfKeys);
+        if (cfg.format == FORMAT_TEXT) {
+            cout<<"Validation: sum of keys according to the data structure = "<<dsSumOfKeys<<" and sum of keys according to the threads = "<<threadsSumOfKeys<<".";
+            cout<<(result.validated ? " OK." : " FAILED.")<<endl;
+            cout<<"sizeChecksum="<<sizeChecksum.getTotal()<<endl;
+            cout<<"completedOperations="<<result.completedOperations<<endl;
+            cout<<"throughput="<<(long long) result.throughput<<endl;
+            if (cfg.scanThreads > 0) {
+                cout<<"scans="<<numScans<<" average_scan_ms="<<(numScans ? (double) scanMillis / numScans : 0)<<endl;
+            }
+            if (cfg.rangeQueryPercent > 0) {
+                auto rqs = numRangeQueries.getTotal();
+                cout<<"range_queries="<<rqs<<" average_range_query_keys="<<(rqs ? (double) rangeQueryKeys.getTotal() / rqs : 0)<<endl;
+            }
+            cout<<endl;
+        }
+        if (garbage == 0) cout<<endl; // "use" garbage, so the return values of all contains() are "used," so they can't be optimized out
+        return result;
+    }
+
+public:
+    // factory is a function that returns a new DataStructureType * (deleted at the end of each trial)
+    template <class Factory>
+    static void run(const benchmark_config_t & cfg, Factory factory) {
+        if (!benchmark_has_contains<DataStructureType>::value && cfg.insertPercent + cfg.deletePercent < 100 - 1e-6) {
+            cout<<"ERROR: "<<cfg.name<<" does not support contains, so insert + delete percent must be 100"<<endl;
+            exit(1);
+        }
+        if (!benchmark_has_range_query<DataStructureType>::value && cfg.rangeQueryPercent > 0) {
+            cout<<"ERROR: "<<cfg.name<<" does not support range queries, so the range query percent must be 0"<<endl;
+            exit(1);
+        }
+        if (cfg.rangeQueryPercent > 0 && cfg.rangeQueryWidth > benchmark_range_query_max_keys<DataStructureType>::value) {
+            cout<<"ERROR: "<<cfg.name<<" supports range queries of at most "<<benchmark_range_query_max_keys<DataStructureType>::value<<" keys, so the range query width must be at most that"<<endl;
+            exit(1);
+        }
+        if (cfg.insertPercent + cfg.deletePercent + cfg.rangeQueryPercent > 100 + 1e-6) {
+            cout<<"ERROR: insert + delete + range query percent must be at most 100"<<endl;
+            exit(1);
+        }
+        if (!benchmark_has_scan<DataStructureType>::value && cfg.scanThreads > 0) {
+            cout<<"ERROR: "<<cfg.name<<" does not support concurrent scans, so the number of scan threads must be 0"<<endl;
+            exit(1);
+        }
+        if (!benchmark_has_batch<DataStructureType>::value && cfg.batchSize > 1) {
+            cout<<"ERROR: "<<cfg.name<<" does not support batched operations, so the batch size must be 1"<<endl;
+            exit(1);
+        }
+
+        ElapsedTimer timerFromStart;
+        timerFromStart.startTimer();
+        auto keys = new KeyDistribution(cfg.dist, cfg.keyRangeSize, cfg.totalThreads);
+        if (cfg.format == FORMAT_TEXT) cout<<"key distribution: "<<cfg.dist.toString()<<endl;
+        vector<benchmark_trial_result_t> results;
+        for (int trial=0;trial<cfg.numTrials;++trial) {
+            auto b = new SetBenchmark<DataStructureType>(cfg, factory(), keys, trial);
+            results.push_back(b->runTrial(trial, timerFromStart));
+            delete b;
+            if (!results.back().validated) {
+                cout<<"ERROR: validation failed!"<<endl;
+                exit(-1);
+            }
+        }
+
+        delete keys;
+
+        double mean = 0;
+        for (auto & r : results) mean += r.throughput;
+        mean /= results.size();
+        double variance = 0;
+        for (auto & r : results) variance += (r.throughput - mean) * (r.throughput - mean);
+        double stdev = (results.size() > 1) ? sqrt(variance / (results.size() - 1)) : 0;
+
+        if (cfg.format == FORMAT_TEXT) {
+            cout<<"trials="<<results.size()<<endl;
+            cout<<"throughput_mean="<<(long long) mean<<endl;
+            cout<<"throughput_stdev="<<(long long) stdev<<endl;
+            cout<<"total elapsed time="<<(timerFromStart.getElapsedMillis()/1000.)<<"s"<<endl;
+        } else if (cfg.format == FORMAT_CSV) {
+            cout<<"name,threads,keyRange,dist,insertPercent,deletePercent,millis,trial,prefillSize,completedOperations,throughput"<<endl;
+            for (int i=0;i<(int) results.size();++i) {
+                auto & r = results[i];
+                cout<<cfg.name<<","<<cfg.totalThreads<<","<<cfg.keyRangeSize<<","<<cfg.dist.toString()<<","<<cfg.insertPercent<<","<<cfg.deletePercent<<","
+                    <<cfg.millisToRun<<","<<i<<","<<r.prefillSize<<","<<r.completedOperations<<","<<(long long) r.throughput<<endl;
+            }
+        } else {
+            cout<<"{\"name\": \""<<cfg.name<<"\", \"threads\": "<<cfg.totalThreads<<", \"keyRange\": "<<cfg.keyRangeSize
+                <<", \"dist\": \""<<cfg.dist.toString()<<"\", \"insertPercent\": "<<cfg.insertPercent<<", \"deletePercent\": "<<cfg.deletePercent
+                <<", \"millis\": "<<cfg.millisToRun<<", \"warmupMillis\": "<<cfg.warmupMillis<<", \"trials\": [";
+            for (int i=0;i<(int) results.size();++i) {
+                auto & r = results[i];
+                cout<<(i ? ", " : "")<<"{\"prefillSize\": "<<r.prefillSize<<", \"completedOperations\": "<<r.completedOperations
+                    <<", \"throughput\": "<<(long long) r.throughput<<"}";
+            }
+            cout<<"], \"throughputMean\": "<<(long long) mean<<", \"throughputStdev\": "<<(long long) stdev<<"}"<<endl;
+        }
+    }
+};
@@ -54,13 +54,15 @@ public:
     counter(int _numThreads, int64_t _globalCounter = 0) : numThreads(_numThreads), globalCounter(_globalCounter) {
         for (int i=0;i<MAX_THREADS;++i) subcounters[i].v = 0;
     }
+    // returns the amount added to the global counter (0 unless this increment flushed the subcounter)
     int64_t inc(int tid) {
         auto val = ++subcounters[tid].v;
         if (val >= max(1000, 30*numThreads)) {
             globalCounter.fetch_add(val);
             subcounters[tid].v = 0;
+            return val;
         }
-        return -1;
+        return 0;
     }
     int64_t set(int64_t value) {
         globalCounter = value;
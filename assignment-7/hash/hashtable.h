@@ -3,10 +3,15 @@
 #include <atomic>
 #include "util.h"
 #include "tle.h"
+#include "resize_policy.h"
 #include <cassert>
 
 using namespace std;
 
+// resizing follows a resize_policy_t: approxInserts counts buckets that went from EMPTY to holding a key
+// (used buckets = live keys + tombstones), and approxDeletes counts tombstones.
+// if too many buckets are used, the table is grown, shrunk or cleaned up (tombstones are removed in place),
+// depending on how many of them hold live keys. if too few keys are live after an erase, the table is shrunk.
 class TLEHashTableExpand {
 private:
     enum {
@@ -23,17 +28,21 @@ private:
     int64_t oldCapacity;
     counter * approxInserts;                // only create ONCE in the constructor, then use set() to reset its value if needed
     counter * approxDeletes;                // only create ONCE in the constructor, then use set() to reset its value if needed
+    resize_policy_t policy;
+    int64_t numResizes[RESIZE_CLEANUP+1];   // number of resizes of each kind (indexed by resize_action_t)
     char padding1[PADDING_BYTES];
 
     bool isExpandNeeded(const int tid, int64_t probeCount);
+    bool isShrinkNeeded(const int tid);
     void expand(const int tid);
+    void cleanupInPlace(const int tid);
     int64_t getAccurateSize();
     
     bool sequentialInsert(const int tid, const int & key, bool disableExpansion, TLEGuard* tle_guard);
-    bool sequentialErase(const int tid, const int & key);
+    bool sequentialErase(const int tid, const int & key, TLEGuard* tle_guard);
 
 public:
-    TLEHashTableExpand(const int _numThreads, const int64_t _capacity);
+    TLEHashTableExpand(const int _numThreads, const int64_t _capacity, const resize_policy_t & _policy = resize_policy_t());
     ~TLEHashTableExpand();
     bool insertIfAbsent(const int tid, const int & key);
     bool erase(const int tid, const int & key);
@@ -42,9 +51,13 @@ public:
 };
 
 // _capacity is the INITIAL size of the hash table (maximum number of elements it can contain WITHOUT expansion)
-TLEHashTableExpand::TLEHashTableExpand(const int _numThreads, const int64_t _capacity) {
+// _policy determines when the table is grown, shrunk or cleaned up (its minCapacity defaults to _capacity)
+TLEHashTableExpand::TLEHashTableExpand(const int _numThreads, const int64_t _capacity, const resize_policy_t & _policy) {
     numThreads = _numThreads;
     capacity = _capacity;
+    policy = _policy;
+    if (policy.minCapacity == 0) policy.minCapacity = _capacity;
+    for (auto & n : numResizes) n = 0;
     data = new volatile int[capacity];
     for (int64_t i=0;i<capacity;++i) data[i] = EMPTY;
     approxInserts = new counter(numThreads);
@@ -67,36 +80,81 @@ int64_t TLEHashTableExpand::getAccurateSize() {
     return accurateInserts - accurateDeletes;
 }
 
+// too many used buckets (live keys + tombstones)?
 bool TLEHashTableExpand::isExpandNeeded(const int tid, int64_t probeCount) {
-    return ((approxInserts->get() > capacity/2) ||
-            (probeCount > 100 && approxInserts->getAccurate() > capacity/2));
+    const double maxUsed = policy.maxLoadFactor * capacity;
+    return ((approxInserts->get() > maxUsed) ||
+            (probeCount > 100 && approxInserts->getAccurate() > maxUsed));
 }
 
+// too few live keys? (only called when an erase flushes its subcounter, so it rarely reads the counters)
+bool TLEHashTableExpand::isShrinkNeeded(const int tid) {
+    return (capacity > policy.minCapacity &&
+            approxInserts->get() - approxDeletes->get() < policy.minLoadFactor * capacity);
+}
+
+// grow, shrink or clean up the table, as the resize policy dictates (using accurate counts)
 void TLEHashTableExpand::expand(const int tid) {
     int64_t expansionStartTime = debugTimer.getElapsedMillis();
 
-    if(old != NULL) delete[] old;
-    old = data;
-    oldCapacity = capacity;
-    
-    capacity = getAccurateSize() * 4;
-    data = new volatile int[capacity];
-    for (int64_t i=0;i<capacity;++i) data[i] = EMPTY;
+    int64_t live = getAccurateSize();
+    auto action = policy.getAction(capacity, live, approxInserts->getAccurate());
+    if (action == RESIZE_NONE) return;
+    ++numResizes[action];
+    int64_t prevCapacity = capacity;
 
-    // EXPANSION CODE HERE :)
-    for(int i = 0; i < oldCapacity; ++i){
-        int key = old[i];
-        if(key != TOMBSTONE && key != EMPTY){
-            sequentialInsert(tid, key, true, NULL);
+    if (action == RESIZE_CLEANUP) {
+        cleanupInPlace(tid);
+    } else {
+        if(old != NULL) delete[] old;
+        old = data;
+        oldCapacity = capacity;
+
+        capacity = policy.getNewCapacity(live);
+        data = new volatile int[capacity];
+        for (int64_t i=0;i<capacity;++i) data[i] = EMPTY;
+
+        // EXPANSION CODE HERE :)
+        for(int i = 0; i < oldCapacity; ++i){
+            int key = old[i];
+            if(key != TOMBSTONE && key != EMPTY){
+                sequentialInsert(tid, key, true, NULL);
+            }
         }
     }
 
     // suggested adjustment to counters at the end of expansion:
-    approxInserts->set(getAccurateSize());
+    approxInserts->set(live);
     approxDeletes->set(0);
 
     auto expansionEndTime = debugTimer.getElapsedMillis();
-    printf("tid=%d expansion at_ms=%ld duration_ms=%ld oldCapacity=%ld newCapacity=%ld\n", tid, expansionStartTime, (expansionEndTime - expansionStartTime), oldCapacity, capacity);
+    printf("tid=%d %s at_ms=%ld duration_ms=%ld oldCapacity=%ld newCapacity=%ld live=%ld\n", tid, resize_policy_t::toString(action), expansionStartTime, (expansionEndTime - expansionStartTime), prevCapacity, capacity, live);
+}
+
+// remove all tombstones without allocating a new array.
+// starting just after a bucket that was EMPTY (so no probe sequence wraps past it), every key is taken out
+// and re-inserted at the first EMPTY bucket from its hash. keys only ever move backwards along their probe
+// sequence, and a key re-inserted at bucket j leaves no EMPTY bucket between its hash and j.
+void TLEHashTableExpand::cleanupInPlace(const int tid) {
+    int64_t start = 0;
+    while (data[start] != EMPTY) ++start;   // exists, since maxLoadFactor < 1
+    for (int64_t i=0;i<capacity;++i) {
+        if (data[i] == TOMBSTONE) data[i] = EMPTY;
+    }
+    for (int64_t j=1;j<capacity;++j) {
+        int64_t index = (start + j) % capacity;
+        int key = data[index];
+        if (key == EMPTY) continue;
+        data[index] = EMPTY;
+        uint32_t h = murmur3(key);
+        for (uint32_t i = 0; i < capacity; ++i) {
+            uint32_t target = (h + i) % capacity;
+            if (data[target] == EMPTY) {
+                data[target] = key;
+                break;
+            }
+        }
+    }
 }
 
 
@@ -135,7 +193,7 @@ bool TLEHashTableExpand::insertIfAbsent(const int tid, const int & key) {
 }
 
 
-bool TLEHashTableExpand::sequentialErase(const int tid, const int & key){
+bool TLEHashTableExpand::sequentialErase(const int tid, const int & key, TLEGuard* tle_guard = NULL){
     uint32_t h = murmur3(key);
     for(uint32_t i = 0; i < capacity; ++i){
 
@@ -146,7 +204,12 @@ bool TLEHashTableExpand::sequentialErase(const int tid, const int & key){
         }
         else if (found == key){
             data[index] = TOMBSTONE;
-            approxDeletes->inc(tid);
+            if(approxDeletes->inc(tid) && isShrinkNeeded(tid)){
+                if(_xtest() != 0){
+                    tle_guard->explicit_fallback();
+                }
+                expand(tid);
+            }
             return true;
         }
     }
@@ -157,7 +220,7 @@ bool TLEHashTableExpand::sequentialErase(const int tid, const int & key){
 // semantics: try to erase key. return true if successful, and false otherwise
 bool TLEHashTableExpand::erase(const int tid, const int & key) {
     TLEGuard tle_guard = TLEGuard(tid);
-    return sequentialErase(tid, key);
+    return sequentialErase(tid, key, &tle_guard);
 }
 
 // semantics: return the sum of all KEYS in the set
@@ -172,4 +235,23 @@ int64_t TLEHashTableExpand::getSumOfKeys() {
     return sum;
 }
 
-void TLEHashTableExpand::printDebuggingDetails() {}
+// (not thread safe: it reads the table while no operations are running)
+void TLEHashTableExpand::printDebuggingDetails() {
+    // probe length of a key = number of buckets read to find it
+    int64_t live = 0, tombstones = 0, totalProbeLength = 0, maxProbeLength = 0;
+    for (int64_t i=0;i<capacity;++i) {
+        int key = data[i];
+        if (key == EMPTY) continue;
+        if (key == TOMBSTONE) {
+            ++tombstones;
+        } else {
+            ++live;
+            int64_t probeLength = 1 + ((i - (int64_t) (murmur3(key) % capacity)) + capacity) % capacity;
+            totalProbeLength += probeLength;
+            maxProbeLength = max(maxProbeLength, probeLength);
+        }
+    }
+    cout<<"capacity="<<capacity<<" live="<<live<<" tombstones="<<tombstones;
+    cout<<" avgProbeLength="<<(live ? (double) totalProbeLength / live : 0)<<" maxProbeLength="<<maxProbeLength;
+    cout<<" grows="<<numResizes[RESIZE_GROW]<<" shrinks="<<numResizes[RESIZE_SHRINK]<<" cleanups="<<numResizes[RESIZE_CLEANUP]<<endl;
+}